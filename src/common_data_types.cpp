@@ -1,4 +1,108 @@
 #include "common_data_types.h"
+#include "parser.h"
+
+#include <omp.h>
+
+namespace
+{
+
+// bits of the key sorted per radix pass
+constexpr size_t RADIX_BITS = 11;
+constexpr size_t RADIX = 1ul << RADIX_BITS;
+
+/**
+ * @brief stable counting sort of in into out by bucket(in[i])
+ * @note each thread counts and scatters one contiguous chunk, so equal buckets keep their order in
+ *
+ * @return start of each bucket in out, with the total size appended
+ */
+template <class Bucket>
+std::vector<size_t> counting_scatter(const std::vector<size_t> &in, std::vector<size_t> &out, size_t buckets, Bucket bucket)
+{
+    const size_t n = in.size();
+    std::vector<size_t> counts(static_cast<size_t>(omp_get_max_threads()) * buckets, 0ul); // [thread][bucket]
+    std::vector<size_t> starts(buckets + 1ul, 0ul);
+    out.resize(n);
+
+    #pragma omp parallel
+    {
+        const size_t num_threads = omp_get_num_threads();
+        const size_t t = omp_get_thread_num();
+        const size_t begin = n * t / num_threads;
+        const size_t end = n * (t + 1ul) / num_threads;
+        size_t *local = counts.data() + t * buckets;
+
+        for (size_t i = begin; i < end; ++i)
+        {
+            ++local[bucket(in[i])];
+        }
+
+        // exclusive prefix sum in (bucket, thread) order
+        #pragma omp barrier
+        #pragma omp single
+        {
+            size_t total = 0ul;
+            for (size_t b = 0; b < buckets; ++b)
+            {
+                starts[b] = total;
+                for (size_t u = 0; u < num_threads; ++u)
+                {
+                    const size_t count = counts[u * buckets + b];
+                    counts[u * buckets + b] = total;
+                    total += count;
+                }
+            }
+            starts[buckets] = total;
+        }
+
+        for (size_t i = begin; i < end; ++i)
+        {
+            out[local[bucket(in[i])]++] = in[i];
+        }
+    }
+
+    return starts;
+}
+
+/**
+ * @brief LSD radix sort of indices into keys
+ *
+ * @return indices ordered by key, ties in index order
+ */
+std::vector<size_t> radix_order(const std::vector<time_t> &keys)
+{
+    std::vector<size_t> order(keys.size());
+    std::iota(order.begin(), order.end(), 0ul);
+    if (keys.empty())
+    {
+        return order;
+    }
+
+    time_t lo = keys.front();
+    time_t hi = keys.front();
+    #pragma omp parallel for reduction(min : lo) reduction(max : hi)
+    for (size_t i = 0; i < keys.size(); ++i)
+    {
+        lo = std::min(lo, keys[i]);
+        hi = std::max(hi, keys[i]);
+    }
+
+    // only as many passes as the spread of keys needs, usually 2 for a few days of timestamps
+    const uint64_t range = static_cast<uint64_t>(hi - lo);
+    std::vector<size_t> scratch;
+    for (size_t shift = 0; shift == 0 || (shift < 64 && (range >> shift) > 0); shift += RADIX_BITS)
+    {
+        counting_scatter(order, scratch, RADIX, [&keys, lo, shift](size_t i)
+        {
+            return (static_cast<uint64_t>(keys[i] - lo) >> shift) & (RADIX - 1ul);
+        });
+        order.swap(scratch);
+    }
+
+    return order;
+}
+
+} // namespace
 
 /**
  * @brief constructor for flight_finder
@@ -7,22 +111,50 @@
  * @param origin optional origin airport all itineraries have to depart from
  */
 flight_finder::flight_finder(std::vector<flight> &&f, const std::optional<airport> &origin)
-    : origin(origin), flights(std::move(f))
+    : flight_finder(std::move(f), flight_constraints{.origin = origin})
 {
+}
 
+/**
+ * @brief constructor for flight_finder
+ *
+ * @param f rvalue of allowed flights
+ * @param constrs constraints the flights were parsed with, for the ones applied during search
+ */
+flight_finder::flight_finder(std::vector<flight> &&f, const flight_constraints &constrs)
+    : admitted(constrs), origin(constrs.origin), rules(constrs.rules), layout(constrs.layout), prefetch(constrs.prefetch), memoize(constrs.memoize)
+{
+#ifndef NDEBUG
     // check ids
-    for (size_t i = 0; i < flights.size(); ++i)
+    for (size_t i = 0; i < f.size(); ++i)
     {
-        assert(flights[flight_id(i)].id == i);
+        assert(f[i].id == i);
     }
+#endif // NDEBUG
 
-    auto compare = [](const flight &lhs, const flight &rhs)
+    // stable sort by arrival, flights arriving at the same time keep their input order
+    std::vector<time_t> arrivals(f.size());
+    #pragma omp parallel for
+    for (size_t i = 0; i < f.size(); ++i)
     {
-        return lhs.arrive_ts < rhs.arrive_ts;
-    };
-    std::sort(flights.vec.begin(), flights.vec.end(), compare);
+        arrivals[i] = f[i].arrive_ts;
+    }
+    const std::vector<size_t> order = radix_order(arrivals);
+
+    // move into place, reassigning ids
+    flights.vec.resize(f.size());
+    seq.vec.resize(f.size());
+    #pragma omp parallel for
+    for (size_t i = 0; i < order.size(); ++i)
+    {
+        flights.vec[i] = std::move(f[order[i]]);
+        flights.vec[i].id = i;
+        seq.vec[i] = order[i];
+    }
+    next_seq = f.size();
+    f.clear();
 
-    // reassign ids, if changed during sorting
+#ifndef NDEBUG
     time_t curr_ts = 0l;
     for (size_t i = 0; i < flights.size(); ++i)
     {
@@ -30,25 +162,77 @@ flight_finder::flight_finder(std::vector<flight> &&f, const std::optional<airpor
         curr_ts = flights[flight_id(i)].arrive_ts;
 
         assert(flights[flight_id(i)].arrive_ts > flights[flight_id(i)].depart_ts);
+    }
+#endif // NDEBUG
 
-        flights[flight_id(i)].id = i;
+    // remove flights that can't affect the result before building anything on top of them
+    pruned.total = flights.size();
+    if (origin.has_value())
+    {
+        prune_unreachable();
     }
+    prune_dominated();
 
-    // build airport nodes
-    for (size_t i = 0; i < flights.size(); ++i)
+    id_of_seq.assign(next_seq, id_vec<flight_id, flight>::INVALID_ID);
+    index_seqs(0ul);
+    build_nodes();
+}
+
+/**
+ * @brief bucket flights into airport nodes by arrival airport
+ * @note two passes, counting per airport then scattering, so every array is allocated once
+ */
+void flight_finder::build_nodes()
+{
+    std::vector<size_t> ids(flights.size());
+    std::iota(ids.begin(), ids.end(), 0ul);
+
+    std::vector<size_t> by_airport;
+    const std::vector<size_t> starts = counting_scatter(ids, by_airport, INVALID_AIRPORT + 1ul, [this](size_t i)
     {
-        airport depart_airport = flights[flight_id(i)].from;
-        airport arrival_airport = flights[flight_id(i)].to;
+        return static_cast<size_t>(flights.vec[i].to);
+    });
 
-        // default construct in case it doesn't exist already
-        // relavant in small datasets where some airports have departing flights but not arriving ones
-        nodes[depart_airport];
+    // airports with departing flights but no arriving ones still get a node
+    // relavant in small datasets
+    std::vector<bool> present(INVALID_AIRPORT + 1ul, false);
+    for (const flight &fl : flights.vec)
+    {
+        present[fl.from] = true;
+        present[fl.to] = true;
+    }
+
+    for (size_t a = 0; a < present.size(); ++a)
+    {
+        if (!present[a])
+        {
+            continue;
+        }
+
+        airport_node &node = nodes[static_cast<airport>(a)];
+        node.arriving_flights.vec.assign(by_airport.begin() + starts[a], by_airport.begin() + starts[a + 1ul]);
+        if (layout == OptLayout::AIRPORT)
+        {
+            node.opt_table.vec.assign(starts[a + 1ul] - starts[a], itinerary());
+        }
+    }
+    if (layout == OptLayout::ARRIVAL)
+    {
+        opt_flat.vec.assign(flights.size(), itinerary());
+    }
+    build_departures();
 
-        nodes[arrival_airport].opt_table.vec.push_back(itinerary());
-        flight_indices.vec.push_back(flight_idx(nodes[arrival_airport].arriving_flights.size()));
-        nodes[arrival_airport].arriving_flights.vec.push_back(flight_id(i));
+    flight_indices.vec.assign(flights.size(), flight_idx(id_vec<flight_idx, flight_id>::INVALID_ID));
+    #pragma omp parallel for
+    for (size_t a = 0; a < present.size(); ++a)
+    {
+        for (size_t pos = starts[a]; pos < starts[a + 1ul]; ++pos)
+        {
+            flight_indices.vec[by_airport[pos]] = flight_idx(pos - starts[a]);
+        }
     }
 
+#ifndef NDEBUG
     // validation
     for (size_t i = 0; i < flights.size(); ++i)
     {
@@ -60,7 +244,7 @@ flight_finder::flight_finder(std::vector<flight> &&f, const std::optional<airpor
     }
     for (const auto &pair : nodes)
     {
-        assert(pair.second.opt_table.size() == pair.second.arriving_flights.size());
+        assert(layout != OptLayout::AIRPORT || pair.second.opt_table.size() == pair.second.arriving_flights.size());
 
         for (size_t i = 0; i < pair.second.arriving_flights.size(); ++i)
         {
@@ -71,10 +255,571 @@ flight_finder::flight_finder(std::vector<flight> &&f, const std::optional<airpor
             assert(pair.first == flights[id].to);
         }
     }
+#endif // NDEBUG
 }
 
-// parse input parameters
-flight_constraints cli(const std::string &name, int argc, char **argv)
+/**
+ * @brief bucket flights into their departure airport's node in departure order
+ */
+void flight_finder::build_departures()
+{
+    std::vector<time_t> departures(flights.size());
+    #pragma omp parallel for
+    for (size_t i = 0; i < flights.size(); ++i)
+    {
+        departures[i] = flights.vec[i].depart_ts;
+    }
+    const std::vector<size_t> by_depart = radix_order(departures);
+
+    std::vector<size_t> by_airport;
+    const std::vector<size_t> starts = counting_scatter(by_depart, by_airport, INVALID_AIRPORT + 1ul, [this](size_t i)
+    {
+        return static_cast<size_t>(flights.vec[i].from);
+    });
+
+    for (auto &[ap, node] : nodes)
+    {
+        node.departing_flights.assign(by_airport.begin() + starts[ap], by_airport.begin() + starts[ap + 1ul]);
+    }
+    departure_order.assign(by_depart.begin(), by_depart.end());
+}
+
+/**
+ * @brief forward sweep over departures marking flights reachable from origin, the rest are dropped
+ * @note itineraries not starting at origin never win against one that does, so dropping flights
+ *       only they could use leaves the result unchanged
+ */
+void flight_finder::prune_unreachable()
+{
+    assert(origin.has_value());
+
+    std::vector<time_t> departures(flights.size());
+    for (size_t i = 0; i < flights.size(); ++i)
+    {
+        departures[i] = flights.vec[i].depart_ts;
+    }
+    const std::vector<size_t> by_depart = radix_order(departures);
+
+    // earliest time we can be at each airport, origin is available from the start
+    std::vector<time_t> earliest(INVALID_AIRPORT + 1, std::numeric_limits<time_t>::max());
+    earliest[origin.value()] = std::numeric_limits<time_t>::min();
+
+    // a flight departs before any flight connecting from it does, so one pass is enough
+    std::vector<bool> reachable(flights.size(), false);
+    for (size_t i : by_depart)
+    {
+        const flight &f = flights.vec[i];
+        if (earliest[f.from] <= f.depart_ts)
+        {
+            reachable[i] = true;
+            earliest[f.to] = std::min(earliest[f.to], f.arrive_ts);
+        }
+    }
+
+    for (size_t i = 0; i < flights.size(); ++i)
+    {
+        if (!reachable[i])
+        {
+            pruned_flights.push_back({flights.vec[i], seq.vec[i], id_vec<flight_id, flight>::INVALID_ID});
+        }
+    }
+
+    const size_t before = flights.size();
+    compact(reachable);
+    pruned.unreachable += before - flights.size();
+}
+
+/**
+ * @brief sort flights by route and sweep each route, dropping flights another one dominates
+ * @note flight g dominates f if both fly the same route with the same number of legs, g departs no
+ *       earlier and arrives at the same time, and g is later in arrival order. any itinerary using f
+ *       can use g instead and win the tiebreak, so f never appears in the result. a g arriving strictly
+ *       earlier would lose the tiebreak, so it is not allowed to dominate. with a max layover, departing
+ *       later can miss a connection f makes, so g has to depart at the same time
+ */
+void flight_finder::prune_dominated()
+{
+    std::vector<size_t> by_route(flights.size());
+    std::iota(by_route.begin(), by_route.end(), 0ul);
+    std::sort(by_route.begin(), by_route.end(), [this](size_t lhs, size_t rhs)
+    {
+        const flight &l = flights.vec[lhs];
+        const flight &r = flights.vec[rhs];
+        return std::tie(l.from, l.to, l.num_stops, l.arrive_ts, l.id) < std::tie(r.from, r.to, r.num_stops, r.arrive_ts, r.id);
+    });
+
+    auto same_group = [this](size_t lhs, size_t rhs) -> bool
+    {
+        const flight &l = flights.vec[lhs];
+        const flight &r = flights.vec[rhs];
+        return l.from == r.from && l.to == r.to && l.num_stops == r.num_stops && l.arrive_ts == r.arrive_ts;
+    };
+
+    // sweep each group backwards, remembering the latest departure seen so far
+    std::vector<bool> keep(flights.size(), true);
+    std::vector<size_t> dominator(flights.size(), id_vec<flight_id, flight>::INVALID_ID);
+    const bool bounded = rules.bounded();
+    size_t end = by_route.size();
+    while (end > 0)
+    {
+        size_t best = by_route[end - 1];
+        size_t begin = end - 1;
+        while (begin > 0 && same_group(by_route[begin - 1], best))
+        {
+            const size_t i = by_route[--begin];
+            if (bounded ? flights.vec[best].depart_ts == flights.vec[i].depart_ts : flights.vec[best].depart_ts >= flights.vec[i].depart_ts)
+            {
+                keep[i] = false;
+                dominator[i] = best;
+            }
+            else
+            {
+                best = i;
+            }
+        }
+        end = begin;
+    }
+
+    for (size_t i = 0; i < flights.size(); ++i)
+    {
+        if (!keep[i])
+        {
+            assert(keep[dominator[i]]);
+            pruned_flights.push_back({flights.vec[i], seq.vec[i], seq.vec[dominator[i]]});
+        }
+    }
+
+    const size_t before = flights.size();
+    compact(keep);
+    pruned.dominated += before - flights.size();
+}
+
+/**
+ * @brief remove flights not marked in keep
+ * @note relative order is unchanged, so comparisons between surviving ids are too
+ */
+void flight_finder::compact(const std::vector<bool>& keep)
+{
+    assert(keep.size() == flights.size());
+
+    size_t next = 0;
+    for (size_t i = 0; i < flights.size(); ++i)
+    {
+        if (keep[i])
+        {
+            if (next != i)
+            {
+                flights.vec[next] = std::move(flights.vec[i]);
+                seq.vec[next] = seq.vec[i];
+            }
+            flights.vec[next].id = next;
+            ++next;
+        }
+    }
+    flights.vec.resize(next);
+    seq.vec.resize(next);
+}
+
+void flight_finder::index_seqs(size_t from)
+{
+    id_of_seq.resize(next_seq, id_vec<flight_id, flight>::INVALID_ID);
+    for (size_t i = from; i < flights.size(); ++i)
+    {
+        if (!flights.vec[i].cancelled)
+        {
+            id_of_seq[seq.vec[i]] = i;
+        }
+    }
+}
+
+/**
+ * @brief merge new flights into the arrival order
+ *
+ * @param f rvalue of flights to add, ids are ignored
+ */
+void flight_finder::add_flights(std::vector<flight> &&f)
+{
+    std::vector<std::pair<flight, size_t> > incoming;
+    for (flight &fl : f)
+    {
+        incoming.emplace_back(std::move(fl), next_seq++);
+    }
+    pruned.total += f.size();
+    f.clear();
+
+    merge_flights(std::move(incoming));
+}
+
+/**
+ * @brief merge flights into the arrival order under the given seqs
+ * @note every opt state only depends on flights arriving before it, so states of flights before the
+ *       earliest arrival merged in stay valid and only the suffix after it needs rebuilding
+ *
+ * @param incoming rvalue of flights and their seqs, ids are ignored
+ */
+void flight_finder::merge_flights(std::vector<std::pair<flight, size_t> > &&incoming)
+{
+    if (incoming.empty())
+    {
+        return;
+    }
+
+    time_t earliest_arrival = std::numeric_limits<time_t>::max();
+    for (const auto &[fl, s] : incoming)
+    {
+        earliest_arrival = std::min(earliest_arrival, fl.arrive_ts);
+    }
+
+    // flights pruned as unreachable might connect from the new ones, bring them back
+    // new flights are not pruned themselves, pruning is only an optimization
+    auto restore = std::partition(pruned_flights.begin(), pruned_flights.end(), [earliest_arrival](const pruned_flight &p)
+    {
+        return p.dominator_seq != id_vec<flight_id, flight>::INVALID_ID || p.f.depart_ts <= earliest_arrival;
+    });
+    for (auto it = restore; it != pruned_flights.end(); ++it)
+    {
+        incoming.emplace_back(std::move(it->f), it->seq);
+    }
+    pruned.unreachable -= pruned_flights.end() - restore;
+    pruned_flights.erase(restore, pruned_flights.end());
+
+    // same order the constructor would have produced
+    auto before = [](time_t lhs_ts, size_t lhs_seq, time_t rhs_ts, size_t rhs_seq) -> bool
+    {
+        return lhs_ts != rhs_ts ? lhs_ts < rhs_ts : lhs_seq < rhs_seq;
+    };
+    std::sort(incoming.begin(), incoming.end(), [&before](const auto &lhs, const auto &rhs)
+    {
+        return before(lhs.first.arrive_ts, lhs.second, rhs.first.arrive_ts, rhs.second);
+    });
+
+    // first position that changes, everything before it is untouched
+    size_t dirty_from = 0;
+    {
+        size_t lo = 0, hi = flights.size();
+        while (lo < hi)
+        {
+            const size_t mid = lo + (hi - lo) / 2ul;
+            if (before(flights.vec[mid].arrive_ts, seq.vec[mid], incoming.front().first.arrive_ts, incoming.front().second))
+            {
+                lo = mid + 1ul;
+            }
+            else
+            {
+                hi = mid;
+            }
+        }
+        dirty_from = lo;
+    }
+
+    // merge the tail
+    std::vector<flight> tail_flights;
+    std::vector<size_t> tail_seq;
+    tail_flights.reserve(flights.size() - dirty_from + incoming.size());
+    tail_seq.reserve(tail_flights.capacity());
+    size_t old_pos = dirty_from;
+    for (auto &[fl, s] : incoming)
+    {
+        while (old_pos < flights.size() && before(flights.vec[old_pos].arrive_ts, seq.vec[old_pos], fl.arrive_ts, s))
+        {
+            tail_flights.push_back(std::move(flights.vec[old_pos]));
+            tail_seq.push_back(seq.vec[old_pos]);
+            ++old_pos;
+        }
+        tail_flights.push_back(std::move(fl));
+        tail_seq.push_back(s);
+    }
+    for (; old_pos < flights.size(); ++old_pos)
+    {
+        tail_flights.push_back(std::move(flights.vec[old_pos]));
+        tail_seq.push_back(seq.vec[old_pos]);
+    }
+
+    flights.vec.resize(dirty_from);
+    seq.vec.resize(dirty_from);
+    for (size_t i = 0; i < tail_flights.size(); ++i)
+    {
+        tail_flights[i].id = dirty_from + i;
+        flights.vec.push_back(std::move(tail_flights[i]));
+        seq.vec.push_back(tail_seq[i]);
+    }
+    index_seqs(dirty_from);
+
+    // drop everything from dirty_from onwards out of the airport timelines, then append the new tail
+    for (auto &[ap, node] : nodes)
+    {
+        auto comp = [](const flight_id &lhs, size_t rhs) -> bool
+        {
+            return lhs.id < rhs;
+        };
+        auto it = std::lower_bound(node.arriving_flights.vec.begin(), node.arriving_flights.vec.end(), dirty_from, comp);
+        if (layout == OptLayout::AIRPORT)
+        {
+            node.opt_table.vec.resize(it - node.arriving_flights.vec.begin());
+        }
+        node.arriving_flights.vec.erase(it, node.arriving_flights.vec.end());
+    }
+    flight_indices.vec.resize(dirty_from, flight_idx(id_vec<flight_idx, flight_id>::INVALID_ID));
+    for (size_t i = dirty_from; i < flights.size(); ++i)
+    {
+        // default construct in case it doesn't exist already
+        nodes[flights.vec[i].from];
+
+        airport_node &node = nodes[flights.vec[i].to];
+        flight_indices.vec.push_back(flight_idx(node.arriving_flights.size()));
+        node.arriving_flights.vec.push_back(flight_id(i));
+        if (layout == OptLayout::AIRPORT)
+        {
+            node.opt_table.vec.push_back(itinerary());
+        }
+    }
+    if (layout == OptLayout::ARRIVAL)
+    {
+        opt_flat.vec.resize(dirty_from);
+        opt_flat.vec.resize(flights.size());
+    }
+
+    build_departures();
+    reverse_built = false;
+
+    // the suffix is rebuilt anyway, and ids in it moved
+    stale.erase(std::remove_if(stale.begin(), stale.end(), [dirty_from](size_t i)
+    {
+        return i >= dirty_from;
+    }), stale.end());
+    num_built = std::min(num_built, dirty_from);
+}
+
+std::optional<flight_id> flight_finder::find_seq(size_t s) const
+{
+    if (s < id_of_seq.size() && id_of_seq[s] != id_vec<flight_id, flight>::INVALID_ID)
+    {
+        return flight_id(id_of_seq[s]);
+    }
+    return std::nullopt;
+}
+
+/**
+ * @brief dominated flights share their dominator's arrival, so this invalidates the suffix from there
+ */
+void flight_finder::restore_dominated(const std::unordered_set<size_t> &dominators)
+{
+    auto restore = std::partition(pruned_flights.begin(), pruned_flights.end(), [&dominators](const pruned_flight &p)
+    {
+        return !dominators.count(p.dominator_seq);
+    });
+    if (restore == pruned_flights.end())
+    {
+        return;
+    }
+
+    std::vector<std::pair<flight, size_t> > incoming;
+    for (auto it = restore; it != pruned_flights.end(); ++it)
+    {
+        incoming.emplace_back(std::move(it->f), it->seq);
+    }
+    pruned.dominated -= incoming.size();
+    pruned_flights.erase(restore, pruned_flights.end());
+
+    merge_flights(std::move(incoming));
+}
+
+/**
+ * @brief cancel a flight without shifting any ids
+ * @note a cancelled flight's opt state is just the one before it, so only flights connecting from it,
+ *       directly or through states that change as a result, are recomputed
+ *
+ * @param s seq of the flight, see flight_finder::seq
+ */
+void flight_finder::remove_flight(size_t s)
+{
+    remove_flights({s});
+}
+
+/**
+ * @brief cancel many flights in one pass over the loaded ones, see remove_flight()
+ *
+ * @param s seqs of the flights, see flight_finder::seq
+ */
+void flight_finder::remove_flights(const std::vector<size_t> &s)
+{
+    const std::unordered_set<size_t> removed(s.begin(), s.end());
+
+    // every seq resolves to a loaded or a pruned flight before anything changes
+    std::vector<flight_id> live;
+    size_t found = 0;
+    for (size_t r : removed)
+    {
+        if (const std::optional<flight_id> id = find_seq(r))
+        {
+            live.push_back(id.value());
+            ++found;
+        }
+    }
+    for (const pruned_flight &p : pruned_flights)
+    {
+        found += removed.count(p.seq);
+    }
+    assert_m(found == removed.size(), "only " + std::to_string(found) + " of " + std::to_string(removed.size()) + " flights to remove are loaded");
+
+    // never made it into the search
+    auto gone = std::partition(pruned_flights.begin(), pruned_flights.end(), [&removed](const pruned_flight &p)
+    {
+        return !removed.count(p.seq);
+    });
+    for (auto it = gone; it != pruned_flights.end(); ++it)
+    {
+        (it->dominator_seq == id_vec<flight_id, flight>::INVALID_ID ? pruned.unreachable : pruned.dominated) -= 1ul;
+    }
+    pruned_flights.erase(gone, pruned_flights.end());
+
+    for (const flight_id &id : live)
+    {
+        flights[id].cancelled = true;
+        id_of_seq[seq[id]] = id_vec<flight_id, flight>::INVALID_ID;
+        stale.push_back(id.id);
+    }
+    reverse_built = false;
+
+    restore_dominated(removed);
+}
+
+/**
+ * @brief change a flight, recomputing as little as the change allows
+ *
+ * @param s seq of the flight, see flight_finder::seq
+ * @param f new details, id is ignored
+ */
+void flight_finder::update_flight(size_t s, flight f)
+{
+    // the finder would never have loaded it like this
+    if (!admits(f, admitted))
+    {
+        remove_flight(s);
+        return;
+    }
+
+    auto p = std::find_if(pruned_flights.begin(), pruned_flights.end(), [s](const pruned_flight &pf)
+    {
+        return pf.seq == s;
+    });
+    const std::optional<flight_id> id = p == pruned_flights.end() ? find_seq(s) : std::nullopt;
+    assert_m(p != pruned_flights.end() || id.has_value(), "no flight " + std::to_string(s) + " to update");
+
+    const flight &old = id.has_value() ? flights[id.value()] : p->f;
+    const bool same_schedule = old.from == f.from && old.to == f.to && old.depart_ts == f.depart_ts && old.arrive_ts == f.arrive_ts;
+
+    if (!id.has_value() || !same_schedule)
+    {
+        // pruned, or somewhere else in the arrival order, take it out and merge the new version in
+        // under the same seq, so it breaks ties the way it did before
+        remove_flight(s);
+
+        std::vector<std::pair<flight, size_t> > incoming;
+        incoming.emplace_back(std::move(f), s);
+        merge_flights(std::move(incoming));
+        return;
+    }
+
+    const bool same_stops = old.num_stops == f.num_stops;
+    f.id = id.value().id;
+    f.cancelled = false;
+    flights[id.value()] = std::move(f);
+
+    if (!same_stops)
+    {
+        stale.push_back(id.value().id);
+        reverse_built = false;
+
+        // dominance needs the same number of stops
+        restore_dominated({s});
+    }
+}
+
+/**
+ * @brief constructor for flight_window
+ *
+ * @param load returns the flights searched for one departure date
+ * @param first_day first departure date in the window, days since 1970-01-01
+ * @param num_days days in the window
+ * @param constrs constraints passed on to flight_finder
+ */
+flight_window::flight_window(loader load, int first_day, size_t num_days, const flight_constraints &constrs)
+    : load(std::move(load)), constrs(constrs)
+{
+    assert_m(num_days > 0, "empty window");
+
+    for (size_t i = 0; i < num_days; ++i)
+    {
+        segments.push_back({first_day + static_cast<int>(i), 0ul, 0ul});
+    }
+    rebuild();
+}
+
+void flight_window::rebuild()
+{
+    std::vector<flight> all;
+    next_seq = 0;
+    for (segment &seg : segments)
+    {
+        std::vector<flight> f = load(seg.day);
+        seg.first_seq = next_seq;
+        seg.size = f.size();
+        next_seq += f.size();
+        all.insert(all.end(), std::make_move_iterator(f.begin()), std::make_move_iterator(f.end()));
+    }
+
+    for (size_t i = 0; i < all.size(); ++i)
+    {
+        all[i].id = i;
+    }
+    finder.emplace(std::move(all), constrs);
+    cancelled = 0;
+}
+
+/**
+ * @brief load the day after the window and evict its first day
+ */
+void flight_window::advance()
+{
+    const int day = last_day() + 1;
+    std::vector<flight> f = load(day);
+    segments.push_back({day, next_seq, f.size()});
+    next_seq += f.size();
+    finder.value().add_flights(std::move(f));
+
+    const segment old = segments.front();
+    segments.pop_front();
+    std::vector<size_t> seqs(old.size);
+    std::iota(seqs.begin(), seqs.end(), old.first_seq);
+    finder.value().remove_flights(seqs);
+    cancelled += old.size;
+
+    // tombstones only cost memory and scans from here on
+    if (cancelled > next_seq - cancelled)
+    {
+        rebuild();
+    }
+}
+
+// print pruning results
+std::string prune_stats::serialize() const
+{
+    std::stringstream ss;
+
+    const size_t removed = unreachable + dominated;
+    ss << "pruned " << removed << " of " << total << " flights";
+    if (total > 0)
+    {
+        ss << " (" << std::fixed << std::setprecision(1) << 100.0 * removed / total << "%)";
+    }
+    ss << ": " << unreachable << " unreachable from origin, " << dominated << " dominated" << std::endl;
+
+    return ss.str();
+}
+
+// options every binary takes, one per field of flight_constraints
+cxxopts::Options search_options(const std::string &name)
 {
     cxxopts::Options options(name, "Find different flight routes");
 
@@ -85,8 +830,22 @@ flight_constraints cli(const std::string &name, int argc, char **argv)
         ("s,start",    "Earliest departure time, default: any",              cxxopts::value<uint>()) // TODO: take std::string in HH:MM and convert to ts
         ("e,end",      "Latest arrival time, default: any",                  cxxopts::value<uint>()) // TODO: take std::string in HH:MM and convert to ts
         ("d,div_n",    "Mod portion of the number of flights N, default: 1", cxxopts::value<uint>()->default_value("1"))                                                                                                                                                                                                                                                                                                                                                          // take std::string in HH:MM and convert to ts
+        ("m,memoize",  "Memoize subproblems in naive search",               cxxopts::value<bool>()->default_value("false"))
+        ("u,until",    "Latest arrival times to also answer after the search", cxxopts::value<std::vector<uint>>())
+        ("since",      "Earliest departure times to also answer, serial only", cxxopts::value<std::vector<uint>>())
+        ("mct",        "Minimum connection minutes, MIN or AIRPORT=MIN",     cxxopts::value<std::vector<std::string>>())
+        ("max_layover", "Maximum layover minutes, MIN or AIRPORT=MIN",       cxxopts::value<std::vector<std::string>>())
+        ("layout",     "Opt state layout, airport, arrival or step (serial only, ignored by --queries and flightfinderd)", cxxopts::value<std::string>()->default_value("airport"))
+        ("prefetch",   "Flights per prefetched batch with arrival layout, 0 for none", cxxopts::value<size_t>()->default_value("0"))
+        ("deadline_ms", "Milliseconds a search may run before it gives up, default: no limit", cxxopts::value<size_t>())
         ("h,help",     "Print usage");
 
+    return options;
+}
+
+// parse input parameters
+cxxopts::ParseResult parse_options(cxxopts::Options &options, int argc, char **argv)
+{
     auto result = options.parse(argc, argv);
 
     // ############### help ###############
@@ -98,6 +857,12 @@ flight_constraints cli(const std::string &name, int argc, char **argv)
         exit(0);
     }
 
+    return result;
+}
+
+// search constraints out of options parsed with search_options
+flight_constraints search_constraints(const cxxopts::ParseResult &result)
+{
     flight_constraints constrs;
 
     // ############### airline ##############
@@ -150,9 +915,148 @@ flight_constraints cli(const std::string &name, int argc, char **argv)
         constrs.div_n = std::make_optional<uint>(result["div_n"].as<uint>());
     }
 
+    // ############### memoize ###############
+
+    constrs.memoize = result["memoize"].as<bool>();
+
+    // ############### until ###############
+
+    if (result.count("until"))
+    {
+        for (uint ts : result["until"].as<std::vector<uint>>())
+        {
+            constrs.until.push_back(ts);
+        }
+    }
+
+    // ############### since ###############
+
+    if (result.count("since"))
+    {
+        for (uint ts : result["since"].as<std::vector<uint>>())
+        {
+            constrs.since.push_back(ts);
+        }
+    }
+
+    // ############### connection rules ###############
+
+    // MIN applies to every airport, AIRPORT=MIN to one, later entries win
+    auto per_airport = [](const std::vector<std::string> &entries, std::vector<time_t> &seconds)
+    {
+        for (const std::string &entry : entries)
+        {
+            const size_t eq = entry.find('=');
+            const time_t value = std::stol(entry.substr(eq == std::string::npos ? 0 : eq + 1)) * 60l;
+            if (eq == std::string::npos)
+            {
+                std::fill(seconds.begin(), seconds.end(), value);
+            }
+            else
+            {
+                seconds[airport_of_str.at(entry.substr(0, eq))] = value;
+            }
+        }
+    };
+
+    if (result.count("mct"))
+    {
+        per_airport(result["mct"].as<std::vector<std::string>>(), constrs.rules.min_connect);
+
+        // still have to land before taking off
+        for (time_t &mct : constrs.rules.min_connect)
+        {
+            mct = std::max(mct, 1l);
+        }
+    }
+
+    if (result.count("max_layover"))
+    {
+        per_airport(result["max_layover"].as<std::vector<std::string>>(), constrs.rules.max_layover);
+    }
+
+    // ############### layout ###############
+
+    const std::string layout = result["layout"].as<std::string>();
+    assert_m(layout == "airport" || layout == "arrival" || layout == "step", "unknown layout " + layout);
+    constrs.layout = layout == "arrival" ? OptLayout::ARRIVAL : layout == "step" ? OptLayout::STEP : OptLayout::AIRPORT;
+    constrs.prefetch = result["prefetch"].as<size_t>();
+
+    // ############### deadline ###############
+
+    if (result.count("deadline_ms"))
+    {
+        constrs.deadline_ms = std::make_optional<size_t>(result["deadline_ms"].as<size_t>());
+    }
+
     return constrs;
 }
 
+// binaries without options of their own
+flight_constraints cli(const std::string &name, int argc, char **argv)
+{
+    cxxopts::Options options = search_options(name);
+    return search_constraints(parse_options(options, argc, argv));
+}
+
+// fields in a fixed order, unset ones left empty
+std::string index_key(const flight_constraints &constrs)
+{
+    std::stringstream ss;
+
+    std::vector<airline> airlines = constrs.airlines.value_or(std::vector<airline>());
+    std::sort(airlines.begin(), airlines.end());
+    airlines.erase(std::unique(airlines.begin(), airlines.end()), airlines.end());
+    for (airline al : airlines)
+    {
+        ss << al << ",";
+    }
+
+    auto field = [&ss](const auto &value)
+    {
+        ss << "|";
+        if (value.has_value())
+        {
+            ss << value.value();
+        }
+    };
+    field(constrs.fare_class);
+    field(constrs.origin);
+    field(constrs.start_ts);
+    field(constrs.end_ts);
+    field(constrs.div_n);
+    field(constrs.departure_day);
+
+    ss << "|";
+    for (size_t a = 0; a <= INVALID_AIRPORT; ++a)
+    {
+        ss << constrs.rules.min_connect[a] << ":" << constrs.rules.max_layover[a] << ",";
+    }
+    ss << "|" << static_cast<int>(constrs.layout) << "|" << constrs.prefetch;
+
+    return ss.str();
+}
+
+// one query to a long running process, printing help and exiting isn't an option there
+flight_constraints cli_line(const std::string &name, const std::string &line)
+{
+    std::vector<std::string> args = {name};
+    std::stringstream ss(line);
+    for (std::string arg; ss >> arg;)
+    {
+        assert_m(arg != "-h" && arg != "--help", "help is only printed on the command line");
+        args.push_back(std::move(arg));
+    }
+
+    std::vector<char *> argv;
+    for (std::string &arg : args)
+    {
+        argv.push_back(arg.data());
+    }
+
+    return cli(name, static_cast<int>(argv.size()), argv.data());
+}
+
 // print flight
 std::string flight::serialize() const
 {
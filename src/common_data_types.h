@@ -7,11 +7,18 @@
 #include <string>
 #include <sstream>
 #include <unordered_map>
+#include <unordered_set>
 #include <optional>
 #include <exception>
 #include <algorithm>
 #include <iomanip>
 #include <chrono>
+#include <numeric>
+#include <limits>
+#include <functional>
+#include <deque>
+#include <atomic>
+#include <memory>
 // #include <immintrin.h>
 
 #include "utils.h"
@@ -26,6 +33,15 @@ enum class OptLevel {
     PARALLEL = 2,
 };
 
+/**
+ * @brief where serial/parallel keep opt states
+ */
+enum class OptLayout {
+    AIRPORT = 0, // one table per arrival airport, in arrival order
+    ARRIVAL = 1, // one table for all flights in arrival order, dependencies resolved before the dp
+    STEP = 2,    // serial only: per airport, only the arrivals that improved on the one before
+};
+
 /**
  * @brief all unique airlines
  */
@@ -152,6 +168,9 @@ extern std::unordered_map<cabin, std::string> cabin_name;
 // convert user input
 extern std::unordered_map<std::string, cabin> cabin_of_str;
 
+// flight::day of flights that didn't come from a search for one date
+constexpr int NO_DAY = std::numeric_limits<int>::min();
+
 /**
  * @brief one flight
  */
@@ -169,6 +188,8 @@ struct flight
     uint num_stops; // 0 -> nonstop
     cabin fare_class;
     uint price; // in USD
+    int day = NO_DAY;       // departure date searched for, days since 1970-01-01
+    bool cancelled = false; // kept in place so ids don't shift, never flown
 
     std::string serialize() const;
 };
@@ -179,6 +200,8 @@ struct flight_id
     size_t id;
 
     flight_id(size_t id) : id(id) {}
+
+    bool operator==(const flight_id&) const = default;
 };
 
 // singleton for use with id_vec
@@ -189,6 +212,15 @@ struct flight_idx
     flight_idx(size_t id) : id(id) {}
 };
 
+/**
+ * @brief compile-time description of a query, each engine is instantiated once per shape
+ */
+template <bool HasOrigin>
+struct query_shape
+{
+    static constexpr bool has_origin = HasOrigin;
+};
+
 /**
  * @brief represents flights strung together
  */
@@ -207,36 +239,47 @@ struct itinerary
     // print
     std::string serialize(const id_vec<flight_id, flight> flights) const;
 
-    // returns better of two itinerary, taking mandated origin into account
-    static itinerary max(const itinerary& lhs, const itinerary& rhs, const std::optional<airport>& origin) {
+    bool operator==(const itinerary&) const = default;
+
+    // returns better of two itineraries for a query of shape Shape, origin is only read if Shape::has_origin
+    template <class Shape>
+    static const itinerary& better(const itinerary& lhs, const itinerary& rhs, airport origin) {
         // choose itinerary from right origin, if one of them has it
-        if(origin.has_value() && lhs.origin != rhs.origin) {
-            if(lhs.origin == origin.value()) {
-                return lhs;
-            } else if(rhs.origin == origin.value()) {
-                return rhs;
+        if constexpr (Shape::has_origin) {
+            if(lhs.origin != rhs.origin) {
+                if(lhs.origin == origin) {
+                    return lhs;
+                } else if(rhs.origin == origin) {
+                    return rhs;
+                }
             }
         }
 
         // choose itinerary with more legs
         if(lhs.legs != rhs.legs) {
-            itinerary next = lhs.legs > rhs.legs ? lhs : rhs;
-            return next;
+            return lhs.legs > rhs.legs ? lhs : rhs;
         }
-        
+
         // tiebreaker: choose first itinerary with higher flight id
-        for(size_t i = 0; i < std::min(lhs.flight_ids.size(), rhs.flight_ids.size()); ++i) {
-            if(lhs.flight_ids.at(i).id != rhs.flight_ids.at(i).id) {
-                itinerary next = lhs.flight_ids.at(i).id > rhs.flight_ids.at(i).id ? lhs : rhs;
-                return next;
+        const size_t common = std::min(lhs.flight_ids.size(), rhs.flight_ids.size());
+        for(size_t i = 0; i < common; ++i) {
+            if(lhs.flight_ids[i].id != rhs.flight_ids[i].id) {
+                return lhs.flight_ids[i].id > rhs.flight_ids[i].id ? lhs : rhs;
             }
         }
 
         assert(lhs.flight_ids.size() == rhs.flight_ids.size());
-        
+
         // truly equal
-        itinerary next = lhs;
-        return next;
+        return lhs;
+    }
+
+    // returns better of two itinerary, taking mandated origin into account
+    static itinerary max(const itinerary& lhs, const itinerary& rhs, const std::optional<airport>& origin) {
+        if(origin.has_value()) {
+            return better<query_shape<true> >(lhs, rhs, origin.value());
+        }
+        return better<query_shape<false> >(lhs, rhs, INVALID_AIRPORT);
     }
 
     // returns new itinerary as the result of appending a flight to this itinerary
@@ -252,6 +295,39 @@ struct itinerary
 
         return next;
     }
+
+    // returns new itinerary as the result of continuing this itinerary with rest
+    itinerary then(const itinerary& rest, const id_vec<flight_id, flight>& flights) const {
+        itinerary next = *this;
+
+        // ensure rest takes off from the airport we currently at
+        assert(next.flight_ids.size() == 0 || rest.flight_ids.size() == 0 || flights[next.flight_ids.back()].to == flights[rest.flight_ids.front()].from);
+
+        next.flight_ids.insert(next.flight_ids.end(), rest.flight_ids.begin(), rest.flight_ids.end());
+        if(next.flight_ids.size()) {
+            next.origin = flights[next.flight_ids.front()].from;
+        }
+        next.legs += rest.legs;
+
+        return next;
+    }
+};
+
+/**
+ * @brief how long an itinerary may stay on the ground between flights, per connecting airport
+ * @note the next flight always has to take off after the last one lands, so min_connect is at least a second
+ */
+struct connection_rules
+{
+    std::vector<time_t> min_connect = std::vector<time_t>(INVALID_AIRPORT + 1, 1l);                                   // seconds
+    std::vector<time_t> max_layover = std::vector<time_t>(INVALID_AIRPORT + 1, std::numeric_limits<time_t>::max()); // seconds
+
+    // whether some airport limits layovers, a running best in arrival order is only enough to link flights if not
+    bool bounded() const {
+        return std::any_of(max_layover.begin(), max_layover.end(), [](time_t t) {
+            return t != std::numeric_limits<time_t>::max();
+        });
+    }
 };
 
 /**
@@ -265,13 +341,93 @@ struct flight_constraints
     std::optional<airport> origin;                // airport all itineraries have to depart from
     std::optional<time_t> start_ts;               // first ts at which a flight in our itinerary can take off
     std::optional<time_t> end_ts;                 // last ts at which a flight in our itinerary can land
+    std::optional<int> departure_day;             // only flights searched for this departure date, days since 1970-01-01
     std::optional<uint> div_n;                    // taking a mod portion to limit the number of flights considered for queries (e.g. mod 5 --> 20% of N)
+    bool memoize = false;                         // naive only: solve the best continuation after each flight once
+    std::vector<time_t> until;                    // serial/parallel only: latest arrival times answered from the one search
+    std::vector<time_t> since;                    // serial only: earliest departure times answered from the reverse search
+    connection_rules rules;                       // minimum connection time and maximum layover at each airport
+    std::optional<size_t> deadline_ms;            // milliseconds a search may run, naive returns its best so far, the others give up
+    OptLayout layout = OptLayout::AIRPORT;        // serial/parallel only: where opt states are kept, STEP is serial only
+    size_t prefetch = 0;                          // serial with OptLayout::ARRIVAL: flights per prefetched batch, 0 for none
 };
 
 // data sources
 const std::string data_dir_top5 = "naive_test/top_5_airports_flight_arrival_results";
 const std::string data_dir_final = "flight_concurr_arr_results";
 
+/**
+ * @brief with OptLayout::STEP, the opt state at an airport from one arrival until the next step
+ */
+struct opt_step
+{
+    flight_id id;     // flight whose arrival improved the state
+    time_t arrive_ts; // its arrival, what lookups search by
+    itinerary best;
+};
+
+// flights, or naive dfs steps, between looks at a search_deadline
+constexpr size_t DEADLINE_CHECK = 1024;
+
+/**
+ * @brief thrown by a search that ran past its search_deadline, the finder is left as if it never ran
+ */
+struct search_expired : public std::exception
+{
+    const char* what() const noexcept override {
+        return "search ran past its deadline";
+    }
+};
+
+/**
+ * @brief when a search has to give up: at a point in time, once whoever holds the token cancels it, or never
+ */
+struct search_deadline
+{
+    std::optional<std::chrono::steady_clock::time_point> at;
+    std::shared_ptr<const std::atomic<bool> > cancelled;
+
+    // budget from now
+    static search_deadline after(std::chrono::milliseconds budget) {
+        return {std::chrono::steady_clock::now() + budget, nullptr};
+    }
+
+    bool expired() const {
+        return (cancelled && cancelled->load(std::memory_order_relaxed)) || (at.has_value() && std::chrono::steady_clock::now() >= at.value());
+    }
+
+    // throws search_expired once expired, only looking on every DEADLINE_CHECK-th i
+    void check(size_t i) const {
+        if(i % DEADLINE_CHECK == 0ul && expired()) {
+            throw search_expired();
+        }
+    }
+};
+
+/**
+ * @brief dp state of one search, see flight_finder::search(const search_query&, search_workspace&)
+ * only ever touched by the thread running that search, and reusable for the next one on any finder
+ */
+struct search_workspace
+{
+    // by airport, the entries of its opt table that differ from the one before, by arrival
+    // opt tables are monotone in arrival order, so these are usually much shorter
+    std::vector<std::vector<opt_step> > steps;
+
+    // checked while sweeping, steps left behind by an expired search are cleared by the next one
+    search_deadline deadline;
+};
+
+/**
+ * @brief what one search against a shared flight_finder asks for
+ */
+struct search_query
+{
+    std::optional<airport> origin; // mandated origin, has to be the finder's if it was built with one
+    std::optional<time_t> end_ts;  // latest arrival, default: any
+    std::optional<airport> dest;   // only count itineraries ending here, default: any
+};
+
 /**
  * @brief represents one airport and all its incoming flights
  */
@@ -280,10 +436,31 @@ struct airport_node
     airport_node() = default;
 
     // if built, opt_table[idx] is best itinerary after flight idx arrives
+    // empty with OptLayout::ARRIVAL or OptLayout::STEP, see flight_finder::opt_at()
     id_vec<flight_idx, itinerary> opt_table;
 
     // all inbound flights, sorted by arrival time, increaing
     id_vec<flight_idx, flight_id> arriving_flights;
+
+    // all outbound flights, sorted by departure time, increasing
+    // which of them connect from an arriving flight is what its opt state feeds into
+    std::vector<flight_id> departing_flights;
+
+    // if built, cont_table[k] is best itinerary taking off with departing_flights[k] or later
+    std::vector<itinerary> cont_table;
+};
+
+/**
+ * @brief how many flights were dropped before the search, and why
+ */
+struct prune_stats
+{
+    size_t total = 0;       // flights handed to flight_finder
+    size_t unreachable = 0; // can never be flown on an itinerary from origin
+    size_t dominated = 0;   // another flight on the same route always does at least as well
+
+    // print
+    std::string serialize() const;
 };
 
 /**
@@ -293,19 +470,578 @@ class flight_finder
 {
 public:
     flight_finder(std::vector<flight> &&f, const std::optional<airport> &origin);
+    flight_finder(std::vector<flight> &&f, const flight_constraints &constrs);
     
-    // naive/serial/parallel only differ from having different implementations for this function
     // return result of serialize() call on best itinerary
+    // checks the query shape once at runtime, then runs the kernel specialized for it
     template <OptLevel OL>
-    std::string search();
+    std::string search() {
+        if(origin.has_value()) {
+            return search<OL, query_shape<true> >();
+        }
+        return search<OL, query_shape<false> >();
+    }
+
+    // naive/serial/parallel only differ from having different kernels
+    template <OptLevel OL, class Shape>
+    std::string search() {
+        if constexpr (OL == OptLevel::NAIVE) {
+            return naive_kernel<Shape>();
+        } else if constexpr (OL == OptLevel::SERIAL) {
+            return serial_kernel<Shape>();
+        } else {
+            return parallel_kernel<Shape>();
+        }
+    }
+
+    // one search that leaves the finder untouched, so threads can run any number of them on one finder
+    // while nothing modifies it, its dp state lives in ws
+    // a separate engine from search(): a step sweep from the first flight on every call, so it reuses
+    // nothing earlier searches or updates built, and layout and prefetch don't apply to it
+    // the finder still owns the state search() and the updates mutate, this just never touches it
+    // serial only, connection rules and cancelled flights are the finder's
+    std::string search(const search_query& q, search_workspace& ws) const {
+        return search(std::vector<search_query>{q}, ws).front();
+    }
+
+    // several queries with the same origin answered from one sweep, in order
+    std::vector<std::string> search(const std::vector<search_query>& qs, search_workspace& ws) const {
+        assert_m(!qs.empty(), "no queries");
+        for(const search_query& q : qs) {
+            assert_m(q.origin == qs.front().origin, "queries in one sweep need the same origin");
+            assert_m(!origin.has_value() || q.origin == origin, "finder was pruned for another origin");
+        }
+
+        const std::vector<itinerary> best = qs.front().origin.has_value()
+            ? query_kernel<query_shape<true> >(qs, ws)
+            : query_kernel<query_shape<false> >(qs, ws);
+
+        std::vector<std::string> out;
+        for(const itinerary& it : best) {
+            out.push_back(it.serialize(flights));
+        }
+        return out;
+    }
+
+    // a search split by arrival time across processes runs its pieces with these, see sharded_search()
+    // flights are in arrival order, so a range of ids is a range of time
+
+    // step dp over flights [from, to), ws holding the steps of the flights before from, as search(q, ws) keeps them
+    void sweep_range(search_workspace& ws, const std::optional<airport>& q_origin, size_t from, size_t to) const {
+        assert_m(!rules.bounded(), "with a max layover the dp can't be split by time");
+        assert_m(!origin.has_value() || q_origin == origin, "finder was pruned for another origin");
+        if(q_origin.has_value()) {
+            step_sweep<query_shape<true> >(ws, q_origin.value(), from, to);
+        } else {
+            step_sweep<query_shape<false> >(ws, INVALID_AIRPORT, from, to);
+        }
+    }
+
+    // earliest time a flight from from on looks up the state at its departure airport
+    time_t lookup_horizon(size_t from) const {
+        time_t horizon = std::numeric_limits<time_t>::max();
+        for(size_t i = from; i < flights.size(); ++i) {
+            const flight& f = flights[flight_id(i)];
+            horizon = std::min(horizon, std::min(f.arrive_ts, f.depart_ts - rules.min_connect[f.from]));
+        }
+        return horizon;
+    }
+
+    // drop the steps no lookup at or after horizon reads, each airport keeps the last one before it
+    static void trim_steps(search_workspace& ws, time_t horizon) {
+        for(std::vector<opt_step>& steps : ws.steps) {
+            auto comp = [](const time_t& lhs, const opt_step& rhs) -> bool {
+                return lhs < rhs.arrive_ts;
+            };
+            auto it = std::upper_bound(steps.begin(), steps.end(), horizon, comp);
+            if(it != steps.begin()) {
+                steps.erase(steps.begin(), it - 1);
+            }
+        }
+    }
+
+    // answer to q from the steps in ws, which have to be complete from q.end_ts on
+    std::string landed(const search_query& q, const search_workspace& ws) const {
+        const time_t end_ts = q.end_ts.value_or(std::numeric_limits<time_t>::max());
+        if(q.origin.has_value()) {
+            return best_landed<query_shape<true> >(end_ts, q.dest, q.origin.value(), &ws).serialize(flights);
+        }
+        return best_landed<query_shape<false> >(end_ts, q.dest, INVALID_AIRPORT, &ws).serialize(flights);
+    }
+
+    // number of flights, cancelled ones included, and when the id-th of them lands
+    size_t size() const { return flights.size(); }
+    time_t arrival(size_t id) const { return flights[flight_id(id)].arrive_ts; }
+
+    // best itinerary landing by end_ts, only counting ones ending at dest if it has value
+    // answered from the opt tables, after bringing them up to date with engine OL if anything changed
+    template <OptLevel OL>
+    std::string search_ending_by(time_t end_ts, const std::optional<airport>& dest = std::nullopt) {
+        static_assert(OL != OptLevel::NAIVE, "naive search keeps no opt tables");
+        if(origin.has_value()) {
+            if(num_built < flights.size() || !stale.empty()) {
+                search<OL, query_shape<true> >();
+            }
+            return best_ending_by<query_shape<true> >(end_ts, dest).serialize(flights);
+        }
+        if(num_built < flights.size() || !stale.empty()) {
+            search<OL, query_shape<false> >();
+        }
+        return best_ending_by<query_shape<false> >(end_ts, dest).serialize(flights);
+    }
+
+    // best itinerary taking off at or after start_ts, and landing by end_ts if it has value
+    // serial only, answered from reverse tables built over all flights on first use
+    // until, if set, is the deadline of this lookup instead of the one set_deadline() gave
+    std::string search_starting_from(time_t start_ts, const std::optional<time_t>& end_ts = std::nullopt, const std::optional<search_deadline>& until = std::nullopt) {
+        const search_deadline& d = until.has_value() ? until.value() : deadline;
+        build_reverse(d);
+        return lookup_starting_from(start_ts, end_ts, d);
+    }
+
+    // build the reverse tables search_starting_from() reads, unless they're built already
+    // nothing to build with a max layover, where every lookup sweeps its own window
+    void build_reverse(const search_deadline& until) {
+        if(rules.bounded() || reverse_built) {
+            return;
+        }
+        if(origin.has_value()) {
+            reverse_kernel<query_shape<true> >(until);
+        } else {
+            reverse_kernel<query_shape<false> >(until);
+        }
+        reverse_built = true;
+    }
+
+    // search_starting_from() once build_reverse() ran, it only reads the finder, so threads can share one
+    std::string lookup_starting_from(time_t start_ts, const std::optional<time_t>& end_ts, const search_deadline& until) const {
+        assert_m(rules.bounded() || reverse_built, "reverse tables aren't built, see build_reverse()");
+        if(origin.has_value()) {
+            return starting_from<query_shape<true> >(start_ts, end_ts, until).serialize(flights);
+        }
+        return starting_from<query_shape<false> >(start_ts, end_ts, until).serialize(flights);
+    }
+
+    // flights removed during construction
+    const prune_stats& stats() const { return pruned; }
+
+    // deadline of searches from now on, other than search(qs, ws), which takes the one in ws
+    // once it expires dp engines throw search_expired, naive returns its best so far, see partial()
+    void set_deadline(search_deadline d) { deadline = std::move(d); }
+
+    // whether the last naive search ran out of time, its result the best it had found by then
+    bool partial() const { return ran_out; }
+
+    // merge more flights into the loaded set
+    // opt states of flights arriving before all of them stay valid, the next search only recomputes the rest
+    // with a max layover in the rules every search reruns the whole sweep, so this and the updates below save it nothing
+    void add_flights(std::vector<flight> &&f);
+
+    // cancel the s-th flight handed to us, counting across the constructor and add_flights()
+    // it stays in place as a tombstone, the next search only recomputes opt states downstream of it, see add_flights()
+    void remove_flight(size_t s);
+
+    // cancel many flights at once, see remove_flight()
+    void remove_flights(const std::vector<size_t> &s);
+
+    // replace the details of the s-th flight handed to us, see remove_flight()
+    // price and other details the search ignores change in place, a new number of stops recomputes
+    // the states downstream of it, and a new route or schedule cancels it and merges in the new version
+    // a new version the constraints the finder was built with filter out cancels it
+    void update_flight(size_t s, flight f);
 
 protected:
+    // search kernels, each defined in its own engine's source file
+    template <class Shape>
+    std::string naive_kernel();
+    template <class Shape>
+    std::string serial_kernel();
+    template <class Shape>
+    std::string parallel_kernel();
+
+    // serial_kernel() dp with OptLayout::ARRIVAL, defined with it
+    template <class Shape>
+    void arrival_order_kernel();
+
+    // serial_kernel() dp with OptLayout::STEP, including the refresh of stale states, defined with it
+    template <class Shape>
+    void step_kernel();
+
+    // search(const std::vector<search_query>&, search_workspace&) specialized for the query shape, defined with serial_kernel()
+    template <class Shape>
+    std::vector<itinerary> query_kernel(const std::vector<search_query>& qs, search_workspace& ws) const;
+
+    // reverse counterpart of serial_kernel(), fills cont_table of every node, defined with it
+    template <class Shape>
+    void reverse_kernel(const search_deadline& until);
+
+    // lookup behind lookup_starting_from(), defined with serial_kernel()
+    template <class Shape>
+    itinerary starting_from(time_t start_ts, const std::optional<time_t>& end_ts, const search_deadline& until) const;
+
+    // forward search over only the flights inside [start_ts, end_ts], for windows the tables can't answer
+    template <class Shape>
+    itinerary window_kernel(time_t start_ts, time_t end_ts, const search_deadline& until) const;
+
+    // origin for kernels to pass to itinerary::better(), unused unless Shape::has_origin
+    template <class Shape>
+    airport shape_origin() const {
+        if constexpr (Shape::has_origin) {
+            return origin.value();
+        }
+        return INVALID_AIRPORT;
+    }
+
+    // lookup behind search_ending_by(), opt tables must be up to date
+    template <class Shape>
+    itinerary best_ending_by(time_t end_ts, const std::optional<airport>& dest) const {
+        return best_landed<Shape>(end_ts, dest, shape_origin<Shape>(), layout == OptLayout::STEP ? &step_ws : nullptr);
+    }
+
+    // best itinerary landing by end_ts, from the opt tables, or from the steps in ws if given
+    // each table is a running best in arrival order, so the last flight landing by end_ts holds the answer
+    template <class Shape>
+    itinerary best_landed(time_t end_ts, const std::optional<airport>& dest, airport mandated, const search_workspace* ws) const {
+        std::optional<itinerary> best = Shape::has_origin ? std::make_optional(itinerary(mandated)) : std::nullopt;
+        for(const auto& [ap, node] : nodes) {
+            if(dest.has_value() && ap != dest.value()) {
+                continue;
+            }
+
+            auto comp = [this](const time_t& lhs, const flight_id& rhs) -> bool {
+                return lhs < flights[rhs].arrive_ts;
+            };
+            auto it = std::upper_bound(node.arriving_flights.vec.begin(), node.arriving_flights.vec.end(), end_ts, comp);
+            if(it == node.arriving_flights.vec.begin()) {
+                continue;
+            }
+
+            const itinerary blank(ap);
+            const itinerary& candidate = ws ? step_before(ws->steps[ap], end_ts, blank) : opt_at(*(it - 1));
+            best = best.has_value() ? itinerary::better<Shape>(best.value(), candidate, mandated) : candidate;
+        }
+
+        // nothing lands in time
+        return best.value_or(itinerary());
+    }
+
+    // opt state at an airport once everything landing by ts has, from its steps, blank if none improved on it
+    static const itinerary& step_before(const std::vector<opt_step>& steps, time_t ts, const itinerary& blank) {
+        auto comp = [](const time_t& lhs, const opt_step& rhs) -> bool {
+            return lhs < rhs.arrive_ts;
+        };
+        auto it = std::upper_bound(steps.begin(), steps.end(), ts, comp);
+        return it == steps.begin() ? blank : (it - 1)->best;
+    }
+
+    // step dp over flights from on, up to to, into ws, which already holds the steps of the flights before them
+    // with a max layover there's no prefix to keep, the sweep covers every flight and from is ignored
+    template <class Shape>
+    void step_sweep(search_workspace& ws, airport mandated, size_t from, size_t to = std::numeric_limits<size_t>::max()) const {
+        ws.steps.resize(INVALID_AIRPORT + 1ul);
+
+        if(rules.bounded()) {
+            const id_vec<flight_id, itinerary> ends = bounded_sweep<Shape>([this](const flight_id& id) {
+                return !flights[id].cancelled;
+            }, mandated, ws.deadline);
+
+            for(const auto& [ap, node] : nodes) {
+                const itinerary blank(ap);
+                std::vector<opt_step>& steps = ws.steps[ap];
+                steps.clear();
+                for(const flight_id& id : node.arriving_flights.vec) {
+                    const itinerary& prev = steps.empty() ? blank : steps.back().best;
+                    if(!flights[id].cancelled && &itinerary::better<Shape>(ends[id], prev, mandated) == &ends[id]) {
+                        steps.push_back({id, flights[id].arrive_ts, ends[id]});
+                    }
+                }
+            }
+            return;
+        }
+
+        for(size_t i = from; i < std::min(to, flights.size()); ++i) {
+            ws.deadline.check(i - from);
+            const flight_id cur_id = flight_id(i);
+            const flight& cur = flights[cur_id];
+            if(cur.cancelled) {
+                continue;
+            }
+
+            std::vector<opt_step>& dest = ws.steps[cur.to];
+            const itinerary blank(cur.to);
+            const itinerary& prev = dest.empty() ? blank : dest.back().best;
+
+            const itinerary src_blank(cur.from);
+            itinerary incoming = step_before(ws.steps[cur.from], cur.depart_ts - rules.min_connect[cur.from], src_blank).add(cur_id, flights);
+            if(&itinerary::better<Shape>(incoming, prev, mandated) == &incoming) {
+                dest.push_back({cur_id, cur.arrive_ts, std::move(incoming)});
+            }
+        }
+    }
+
+    // opt state of flight id, wherever layout keeps it, never with OptLayout::STEP
+    itinerary& opt_at(const flight_id& id) {
+        return layout == OptLayout::ARRIVAL ? opt_flat[id] : nodes.at(flights[id].to).opt_table[flight_indices[id]];
+    }
+    const itinerary& opt_at(const flight_id& id) const {
+        return layout == OptLayout::ARRIVAL ? opt_flat[id] : nodes.at(flights[id].to).opt_table[flight_indices[id]];
+    }
+
+    // opt state after flight cur_id arrives, from the states of flights arriving before it
+    template <class Shape>
+    itinerary opt_state(const flight_id& cur_id) const {
+        const flight& cur = flights[cur_id];
+        const flight_idx cur_idx = flight_indices[cur_id];
+        const airport_node& dest = nodes.at(cur.to);
+
+        const itinerary blank(cur.to);
+        const itinerary& prev = (cur_idx.id == 0ul) ? blank : opt_at(dest.arriving_flights[flight_idx(cur_idx.id - 1ul)]);
+        if(cur.cancelled) {
+            return prev;
+        }
+
+        // last flight into our departure airport landing early enough to make the connection
+        const airport_node& src = nodes.at(cur.from);
+        auto comp = [this](const flight_id& lhs, const time_t& rhs) -> bool {
+            return flights[lhs].arrive_ts <= rhs;
+        };
+        auto it = std::lower_bound(src.arriving_flights.vec.begin(), src.arriving_flights.vec.end(), cur.depart_ts - rules.min_connect[cur.from], comp);
+
+        // no itinerary in time, use blank itinerary
+        const itinerary incoming = (it == src.arriving_flights.vec.begin())
+            ? itinerary(cur.from).add(cur_id, flights)
+            : opt_at(*(it - 1)).add(cur_id, flights);
+
+        return itinerary::better<Shape>(incoming, prev, shape_origin<Shape>());
+    }
+
+    // recompute opt states of stale flights, and of every flight downstream of one whose state changed
+    // flights only depend on flights with lower ids, so recomputing in id order visits each at most once
+    // never stops for the deadline, stale is gone by the time it's done, stopping half way would lose it
+    template <class Shape>
+    void refresh_stale() {
+        std::vector<size_t> todo; // min heap of ids
+        std::vector<bool> queued(num_built, false);
+        auto push = [this, &todo, &queued](size_t i) {
+            if(i < num_built && !queued[i]) {
+                queued[i] = true;
+                todo.push_back(i);
+                std::push_heap(todo.begin(), todo.end(), std::greater<size_t>());
+            }
+        };
+        for(size_t i : stale) {
+            push(i);
+        }
+        stale.clear();
+
+        while(!todo.empty()) {
+            std::pop_heap(todo.begin(), todo.end(), std::greater<size_t>());
+            const flight_id cur_id = flight_id(todo.back());
+            todo.pop_back();
+
+            const flight& cur = flights[cur_id];
+            const flight_idx cur_idx = flight_indices[cur_id];
+            airport_node& dest = nodes.at(cur.to);
+
+            itinerary next = opt_state<Shape>(cur_id);
+            if(next == opt_at(cur_id)) {
+                continue;
+            }
+            opt_at(cur_id) = std::move(next);
+
+            // the next arrival here carries our state forward
+            const bool last = cur_idx.id + 1ul == dest.arriving_flights.size();
+            if(!last) {
+                push(dest.arriving_flights[flight_idx(cur_idx.id + 1ul)].id);
+            }
+
+            // departures connecting from us, but not from the next arrival
+            // an arrival at the same time as ours leaves nothing for us
+            const time_t mct = rules.min_connect[cur.to];
+            auto comp = [this](const flight_id& lhs, const time_t& rhs) -> bool {
+                return flights[lhs].depart_ts < rhs;
+            };
+            auto begin = std::lower_bound(dest.departing_flights.begin(), dest.departing_flights.end(), cur.arrive_ts + mct, comp);
+            auto end = last ? dest.departing_flights.end()
+                : std::lower_bound(begin, dest.departing_flights.end(), flights[dest.arriving_flights[flight_idx(cur_idx.id + 1ul)]].arrive_ts + mct, comp);
+            for(auto it = begin; it != end; ++it) {
+                push(it->id);
+            }
+        }
+    }
+
+    // itinerary ending with each flight use(id) holds for, linked under rules with a max layover
+    // one sweep over time, flights become connectable min_connect after landing and stop max_layover after
+    // that, each airport keeps the connectable ones in a monotone deque so its front is the best of them
+    template <class Shape, class Use>
+    id_vec<flight_id, itinerary> bounded_sweep(Use use, airport mandated, const search_deadline& until) const {
+        id_vec<flight_id, itinerary> ends(std::vector<itinerary>(flights.size()));
+
+        // flights in the order they become connectable
+        std::vector<flight_id> landed;
+        for(size_t i = 0; i < flights.size(); ++i) {
+            if(use(flight_id(i))) {
+                landed.push_back(flight_id(i));
+            }
+        }
+        auto ready_ts = [this](const flight_id& id) -> time_t {
+            return flights[id].arrive_ts + rules.min_connect[flights[id].to];
+        };
+        std::stable_sort(landed.begin(), landed.end(), [&ready_ts](const flight_id& lhs, const flight_id& rhs) {
+            return ready_ts(lhs) < ready_ts(rhs);
+        });
+
+        // front to back: landed earlier and strictly better than everything behind it
+        std::vector<std::deque<flight_id> > window(INVALID_AIRPORT + 1ul);
+        auto is_better = [&ends, mandated](const flight_id& lhs, const flight_id& rhs) -> bool {
+            return &itinerary::better<Shape>(ends[lhs], ends[rhs], mandated) == &ends[lhs];
+        };
+
+        size_t next_ready = 0;
+        for(size_t k = 0; k < departure_order.size(); ++k) {
+            until.check(k);
+            const flight_id cur_id = departure_order[k];
+            if(!use(cur_id)) {
+                continue;
+            }
+            const flight& cur = flights[cur_id];
+
+            // everything ready by now, their own departures were all before it
+            for(; next_ready < landed.size() && ready_ts(landed[next_ready]) <= cur.depart_ts; ++next_ready) {
+                std::deque<flight_id>& at = window[flights[landed[next_ready]].to];
+                while(!at.empty() && is_better(landed[next_ready], at.back())) {
+                    at.pop_back();
+                }
+                at.push_back(landed[next_ready]);
+            }
+
+            // drop whatever landed too long ago, departures only move forward so it never comes back
+            std::deque<flight_id>& at = window[cur.from];
+            while(!at.empty() && cur.depart_ts - flights[at.front()].arrive_ts > rules.max_layover[cur.from]) {
+                at.pop_front();
+            }
+
+            // starting fresh is always an option, it's the one that counts with a mandated origin
+            const itinerary fresh = itinerary(cur.from).add(cur_id, flights);
+            ends[cur_id] = at.empty() ? fresh : itinerary::better<Shape>(ends[at.front()].add(cur_id, flights), fresh, mandated);
+        }
+
+        return ends;
+    }
+
+    // fill every opt table from a bounded_sweep() over all flights, ignoring num_built and stale
+    // a full sweep on every search, the incremental bookkeeping of add_flights() and the updates is unused here
+    template <class Shape>
+    void bounded_kernel() {
+        const airport mandated = shape_origin<Shape>();
+        const id_vec<flight_id, itinerary> ends = bounded_sweep<Shape>([this](const flight_id& id) {
+            return !flights[id].cancelled;
+        }, mandated, deadline);
+
+        for(auto& [ap, node] : nodes) {
+            const itinerary blank(ap);
+            for(size_t i = 0; i < node.arriving_flights.size(); ++i) {
+                const flight_id id = node.arriving_flights[flight_idx(i)];
+                const itinerary& prev = (i == 0ul) ? blank : opt_at(node.arriving_flights[flight_idx(i - 1ul)]);
+                opt_at(id) = flights[id].cancelled ? prev : itinerary::better<Shape>(ends[id], prev, mandated);
+            }
+        }
+
+        num_built = flights.size();
+        stale.clear();
+    }
+
+    // build nodes and flight_indices from flights
+    void build_nodes();
+
+    // sort each node's departing_flights, after ids changed
+    void build_departures();
+
+    // position of the s-th flight handed to us, if it is loaded and not cancelled
+    std::optional<flight_id> find_seq(size_t s) const;
+
+    // merge flights into the arrival order under the given seqs, restoring pruned flights they make relevant
+    void merge_flights(std::vector<std::pair<flight, size_t> > &&incoming);
+
+    // merge pruned flights dominated by any of these seqs back in, once they no longer dominate them
+    void restore_dominated(const std::unordered_set<size_t> &dominators);
+
+    // drop flights not reachable from origin, only valid if origin has value
+    void prune_unreachable();
+
+    // drop flights made redundant by another flight on the same route
+    void prune_dominated();
+
+    // drop flights with keep[id] == false, reassigning ids in arrival order
+    void compact(const std::vector<bool>& keep);
+
+    // point id_of_seq at the live flights from id from on
+    void index_seqs(size_t from);
+
+    // constraints the flights were parsed with, updates are held to them too
+    flight_constraints admitted;
+
     // origin airport, if has value
     std::optional<airport> origin;
 
+    // how flights may be linked
+    connection_rules rules;
+
+    // where opt states are kept
+    OptLayout layout;
+
+    // flights per batch in arrival_order_kernel(), whose states are prefetched a batch ahead
+    size_t prefetch;
+
+    // steps every search keeps up to date with OptLayout::STEP
+    search_workspace step_ws;
+
+    // see set_deadline() and partial()
+    search_deadline deadline;
+    bool ran_out = false;
+
+    // opt states with OptLayout::ARRIVAL, by flight id
+    id_vec<flight_id, itinerary> opt_flat;
+
+    // naive only, memoize subproblems instead of enumerating every itinerary
+    bool memoize;
+
+    // pruning results
+    prune_stats pruned;
+
+    // a flight removed by pruning, kept in case added flights make it relevant again
+    struct pruned_flight
+    {
+        flight f;
+        size_t seq;           // see flight_finder::seq
+        size_t dominator_seq; // seq of the flight dominating it, INVALID_ID if unreachable from origin
+    };
+    std::vector<pruned_flight> pruned_flights;
+
     // all flights
     id_vec<flight_id, flight> flights;
 
+    // order each flight was handed to us in, breaks ties in arrival time and identifies flights across updates
+    id_vec<flight_id, size_t> seq;
+
+    // seq of the next flight added
+    size_t next_seq = 0ul;
+
+    // id of the live flight with each seq, INVALID_ID while it's pruned or cancelled
+    std::vector<size_t> id_of_seq;
+
+    // opt states of flights [0, num_built) are up to date, except possibly ones downstream of stale
+    size_t num_built = 0ul;
+
+    // flights below num_built whose opt state has to be recomputed by the next search
+    std::vector<size_t> stale;
+
+    // cont tables are up to date, any change to flights clears it
+    bool reverse_built = false;
+
+    // all flights, sorted by departure time, increasing
+    std::vector<flight_id> departure_order;
+
     // flight_idx in corresponding airport, but still need to find out what airport this is
     // unused for naive
     id_vec<flight_id, flight_idx> flight_indices;
@@ -315,9 +1051,76 @@ protected:
     std::unordered_map<airport, airport_node> nodes;
 };
 
-// parse params
+/**
+ * @brief flights of a rolling range of departure dates, one segment per day
+ * @note opt states carry over from one day to the next: advancing merges the new day in, which mostly
+ *       lands after everything loaded, and cancels the day leaving the window, so only states that used
+ *       it are recomputed. cancelled flights are dropped by reloading once they outnumber live ones
+ */
+class flight_window
+{
+public:
+    // flights searched for one departure date, days since 1970-01-01
+    using loader = std::function<std::vector<flight>(int)>;
+
+    flight_window(loader load, int first_day, size_t num_days, const flight_constraints &constrs);
+
+    // slide forward one day
+    void advance();
+
+    // range of departure dates loaded, inclusive
+    int first_day() const { return segments.front().day; }
+    int last_day() const { return segments.back().day; }
+
+    // best itinerary over the flights in the window
+    template <OptLevel OL>
+    std::string search() {
+        return finder.value().search<OL>();
+    }
+
+protected:
+    // flights of one departure date, handed to finder under consecutive seqs
+    struct segment
+    {
+        int day;
+        size_t first_seq;
+        size_t size;
+    };
+
+    // load every day in the window into a new finder
+    void rebuild();
+
+    loader load;
+    flight_constraints constrs;
+    std::deque<segment> segments;
+    std::optional<flight_finder> finder;
+
+    // seq of the next flight handed to finder
+    size_t next_seq = 0ul;
+
+    // flights cancelled since the last rebuild
+    size_t cancelled = 0ul;
+};
+
+// options shared by every binary, each adds its own before parsing
+cxxopts::Options search_options(const std::string &name);
+
+// parse params, printing usage and exiting on --help
+cxxopts::ParseResult parse_options(cxxopts::Options &options, int argc, char **argv);
+
+// flight_constraints out of params parsed from search_options
+flight_constraints search_constraints(const cxxopts::ParseResult &result);
+
+// parse params of a binary without options of its own
 flight_constraints cli(const std::string &name, int argc, char **argv);
 
+// everything in constrs that decides which flights a flight_finder holds and how it searches them
+// queries with equal keys can share one finder
+std::string index_key(const flight_constraints &constrs);
+
+// parse params from one line of whitespace separated arguments, as they would follow the program name
+flight_constraints cli_line(const std::string &name, const std::string &line);
+
 // for testing
 std::string remove_whitespace(const std::string& input);
 
@@ -0,0 +1,422 @@
+// serial.cpp without its main, and without ours either if whoever includes us asked for that
+#ifdef REMOVE_MAIN_FUNC
+#include "serial.cpp"
+#else
+#define REMOVE_MAIN_FUNC
+#include "serial.cpp"
+#undef REMOVE_MAIN_FUNC
+#endif
+#include "queries.h"
+
+#include "scheduler.h"
+#include "shared_dataset.h"
+#include "lib/src/json.hpp"
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <atomic>
+#include <cstring>
+#include <map>
+
+using json = nlohmann::json;
+
+// protocol: a client writes one query per line, the arguments serial.x takes, and reads back one json
+// object per line, in order:
+//   {"ok": true, "flights": N, "generation": G, "result": [legs], "until": [{"end_ts": T, "result": [legs]}],
+//    "since": [{"start_ts": T, "result": [legs]}], "search_us": N}, search_us counting the wait for a worker
+// or {"ok": false, "error": "..."}, "overloaded" when the scheduler turned it away or MAX_BUILDS other
+// finders were being built, "deadline" when the search and its lookups didn't finish within --deadline_ms,
+// counted once its finder is built
+// the line "reload" loads the flights again in the background instead, see resident_index::reload(),
+// and gets {"ok": true, "reloading": false} if a reload was already running
+// a line longer than MAX_LINE gets {"ok": false, "error": "line too long"} and the connection closed, and
+// past MAX_CLIENTS connections a new one gets {"ok": false, "error": "too many clients"} and is closed
+
+// most finders kept built at once, the oldest one goes first
+constexpr size_t MAX_INDEXES = 8;
+
+// most finders queries build at once, a query needing yet another one is turned away
+constexpr size_t MAX_BUILDS = 2;
+
+// longest query line, and most clients connected at once
+constexpr size_t MAX_LINE = 4096;
+constexpr size_t MAX_CLIENTS = 64;
+
+/**
+ * @brief one finder and what it takes to share it between connections
+ */
+struct index_entry
+{
+    flight_constraints constrs;
+    size_t generation; // of the snapshot it was built from
+    std::string key;   // index_key() of constrs and generation
+    std::shared_ptr<flight_finder> finder;
+
+    // --since still builds tables in the finder, so those lookups take turns
+    // the const searches the scheduler runs don't read those tables, so they go on meanwhile
+    std::mutex since_lock;
+};
+
+/**
+ * @brief every flight, parsed into this process or mapped from a shared_dataset other processes map too
+ */
+struct flight_source
+{
+    std::shared_ptr<const std::vector<flight> > parsed;
+    std::shared_ptr<const shared_dataset> mapped;
+
+    size_t size() const { return mapped ? mapped->size() : parsed->size(); }
+
+    // what filter_flights() picks under constrs
+    std::vector<flight> select(const flight_constraints &constrs) const {
+        return mapped ? mapped->select(constrs) : filter_flights(*parsed, constrs);
+    }
+};
+
+/**
+ * @brief one version of the dataset, and the finders built from it so far
+ */
+struct snapshot
+{
+    snapshot(flight_source &&f, size_t gen) : flights(std::move(f)), generation(gen) {}
+
+    const flight_source flights;
+    const size_t generation;
+
+    std::mutex lock;
+    std::map<std::string, std::shared_ptr<index_entry> > entries;
+    std::deque<std::string> order;
+
+    // finders being built, queries wanting one of them wait for it instead of building it again
+    std::map<std::string, std::shared_future<std::shared_ptr<index_entry> > > building;
+};
+
+/**
+ * @brief the current snapshot, safe to use from any thread
+ * a reload builds the next snapshot on its own thread and publishes it with one atomic store, queries
+ * that already hold the old one finish on it, and it's freed once the last of them lets go
+ */
+class resident_index
+{
+public:
+    using loader = std::function<flight_source()>;
+
+    resident_index(loader l) : load(std::move(l)), current(std::make_shared<snapshot>(load(), 0ul)) {}
+
+    // a reload still running finishes first, it uses everything here
+    ~resident_index() {
+        if(reloader.joinable()) {
+            reloader.join();
+        }
+    }
+
+    // finder answering queries under constrs in the current snapshot, built on first use
+    // an evicted entry stays alive for as long as anyone still holds it
+    // nullptr if it isn't built yet and MAX_BUILDS others are being built already
+    std::shared_ptr<index_entry> entry(const flight_constraints &constrs) {
+        return entry(*current.load(), constrs, MAX_BUILDS);
+    }
+
+    // load the flights again in the background and swap them in, false if a reload is already running
+    // finders in use on the old snapshot are built on the new one before it goes live
+    bool reload() {
+        if(reloading.exchange(true)) {
+            return false;
+        }
+
+        // the last reload is done with everything but returning
+        if(reloader.joinable()) {
+            reloader.join();
+        }
+        reloader = std::thread([this]() {
+            try {
+                const std::shared_ptr<snapshot> old = current.load();
+                std::shared_ptr<snapshot> next = std::make_shared<snapshot>(load(), old->generation + 1ul);
+
+                std::vector<flight_constraints> warm;
+                {
+                    std::lock_guard<std::mutex> guard(old->lock);
+                    for(const std::string &key : old->order) {
+                        warm.push_back(old->entries.at(key)->constrs);
+                    }
+                }
+                for(const flight_constraints &constrs : warm) {
+                    entry(*next, constrs, std::numeric_limits<size_t>::max());
+                }
+
+                current.store(std::move(next));
+            } catch(const std::exception &e) {
+                std::cerr << "reload failed, keeping the current flights: " << e.what() << std::endl;
+            }
+            reloading = false;
+        });
+
+        return true;
+    }
+
+    size_t size() const { return current.load()->flights.size(); }
+
+    // of the current snapshot, 0 for the one loaded first
+    size_t generation() const { return current.load()->generation; }
+
+    // whether a reload is running
+    bool busy() const { return reloading; }
+
+protected:
+    // build outside the lock, queries for a key being built wait for that build, nullptr if max_builds
+    // other keys are being built already
+    static std::shared_ptr<index_entry> entry(snapshot &snap, const flight_constraints &constrs, size_t max_builds) {
+        const std::string key = index_key(constrs) + "@" + std::to_string(snap.generation);
+        std::promise<std::shared_ptr<index_entry> > done;
+        {
+            std::unique_lock<std::mutex> guard(snap.lock);
+            auto it = snap.entries.find(key);
+            if(it != snap.entries.end()) {
+                return it->second;
+            }
+            auto pending = snap.building.find(key);
+            if(pending != snap.building.end()) {
+                std::shared_future<std::shared_ptr<index_entry> > wait = pending->second;
+                guard.unlock();
+                return wait.get();
+            }
+            if(snap.building.size() >= max_builds) {
+                return nullptr;
+            }
+            snap.building.emplace(key, done.get_future().share());
+        }
+
+        std::shared_ptr<index_entry> built = std::make_shared<index_entry>();
+        try {
+            built->constrs = constrs;
+            built->generation = snap.generation;
+            built->key = key;
+            built->finder = std::make_shared<flight_finder>(snap.flights.select(constrs), constrs);
+        } catch(...) {
+            {
+                std::lock_guard<std::mutex> guard(snap.lock);
+                snap.building.erase(key);
+            }
+            done.set_exception(std::current_exception());
+            throw;
+        }
+
+        {
+            std::lock_guard<std::mutex> guard(snap.lock);
+            snap.entries.emplace(key, built);
+            snap.order.push_back(key);
+            if(snap.order.size() > MAX_INDEXES) {
+                snap.entries.erase(snap.order.front());
+                snap.order.pop_front();
+            }
+            snap.building.erase(key);
+        }
+        done.set_value(built);
+        return built;
+    }
+
+    loader load;
+    std::atomic<std::shared_ptr<snapshot> > current;
+    std::atomic<bool> reloading = false;
+    std::thread reloader;
+};
+
+namespace
+{
+
+// legs of a serialized itinerary, one per line
+json legs(const std::string &serialized) {
+    json out = json::array();
+    std::stringstream ss(serialized);
+    for(std::string line; std::getline(ss, line);) {
+        if(!line.empty()) {
+            out.push_back(line);
+        }
+    }
+    return out;
+}
+
+// answer one query line, the search and --until lookups go through the scheduler together
+json answer(resident_index &index, query_scheduler &scheduler, const std::string &line) {
+    if(line == "reload") {
+        return {{"ok", true}, {"reloading", index.reload()}};
+    }
+
+    json reply;
+    try {
+        const flight_constraints constrs = cli_line("flightfinderd", line);
+        std::shared_ptr<index_entry> entry = index.entry(constrs);
+        if(!entry) {
+            return {{"ok", false}, {"error", "overloaded"}};
+        }
+
+        time_point<high_resolution_clock> start = high_resolution_clock::now();
+        const search_deadline deadline = constrs.deadline_ms.has_value() ? search_deadline::after(std::chrono::milliseconds(constrs.deadline_ms.value())) : search_deadline();
+        std::vector<std::shared_future<std::string> > results;
+        for(const search_query &q : forward_queries(constrs)) {
+            std::optional<std::shared_future<std::string> > result = scheduler.submit(entry->finder, entry->key, q, deadline);
+            if(!result.has_value()) {
+                return {{"ok", false}, {"error", "overloaded"}};
+            }
+            results.push_back(std::move(result.value()));
+        }
+
+        reply["ok"] = true;
+        reply["flights"] = entry->finder->stats().total;
+        reply["generation"] = entry->generation;
+        reply["result"] = legs(results.front().get());
+        time_point<high_resolution_clock> end = high_resolution_clock::now();
+
+        reply["until"] = json::array();
+        for(size_t i = 0; i < constrs.until.size(); ++i) {
+            reply["until"].push_back({{"end_ts", constrs.until[i]}, {"result", legs(results[i + 1ul].get())}});
+        }
+        reply["since"] = json::array();
+        for(time_t since : constrs.since) {
+            std::lock_guard<std::mutex> guard(entry->since_lock);
+            reply["since"].push_back({{"start_ts", since}, {"result", legs(entry->finder->search_starting_from(since, std::nullopt, deadline))}});
+        }
+        reply["search_us"] = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+    } catch(const search_expired &) {
+        reply = {{"ok", false}, {"error", "deadline"}};
+    } catch(const std::exception &e) {
+        reply = {{"ok", false}, {"error", e.what()}};
+    }
+    return reply;
+}
+
+// write all of msg, false once the client is gone
+bool send_all(int fd, const std::string &msg) {
+    for(size_t sent = 0; sent < msg.size();) {
+        const ssize_t n = send(fd, msg.data() + sent, msg.size() - sent, MSG_NOSIGNAL);
+        if(n <= 0) {
+            return false;
+        }
+        sent += n;
+    }
+    return true;
+}
+
+// answer queries from one client until it hangs up, or sends a line longer than MAX_LINE
+void serve(resident_index &index, query_scheduler &scheduler, int fd) {
+    const std::string too_long = json({{"ok", false}, {"error", "line too long"}}).dump() + "\n";
+    std::string pending;
+    char buf[4096];
+    for(ssize_t n; (n = recv(fd, buf, sizeof(buf), 0)) > 0;) {
+        pending.append(buf, n);
+        for(size_t eol; (eol = pending.find('\n')) != std::string::npos;) {
+            if(eol > MAX_LINE) {
+                send_all(fd, too_long);
+                return;
+            }
+            const std::string line = pending.substr(0, eol);
+            pending.erase(0, eol + 1ul);
+            if(!send_all(fd, answer(index, scheduler, line).dump() + "\n")) {
+                return;
+            }
+        }
+
+        // what's left has no end yet, don't buffer it without bound
+        if(pending.size() > MAX_LINE) {
+            send_all(fd, too_long);
+            return;
+        }
+    }
+}
+
+} // namespace
+
+#ifndef REMOVE_MAIN_FUNC
+/**
+ * @brief flightfinderd options, the search constraints come with each query instead
+ */
+struct daemon_options
+{
+    std::string socket = "flightfinderd.sock"; // unix socket to accept queries on
+    size_t workers = 4;                        // threads running searches
+    size_t max_queued = 64;                    // searches waiting before new ones are turned away
+    std::optional<std::string> dataset;        // shared dataset file to map instead of parsing
+    bool publish = false;                      // parse the flights into the dataset file instead
+};
+
+int main(int argc, char** argv) {
+    cxxopts::Options options("flightfinderd", "Answer flight route queries over a unix socket");
+    options.add_options()
+        ("socket",     "Unix socket to accept queries on", cxxopts::value<std::string>()->default_value("flightfinderd.sock"))
+        ("workers",    "Threads running searches", cxxopts::value<size_t>()->default_value("4"))
+        ("max_queued", "Searches waiting before new ones are turned away", cxxopts::value<size_t>()->default_value("64"))
+        ("dataset",    "Shared dataset file to map instead of parsing", cxxopts::value<std::string>())
+        ("publish",    "Parse the flights into --dataset and exit", cxxopts::value<bool>()->default_value("false"))
+        ("h,help",     "Print usage");
+    const cxxopts::ParseResult result = parse_options(options, argc, argv);
+
+    daemon_options opts;
+    opts.socket = result["socket"].as<std::string>();
+    opts.workers = result["workers"].as<size_t>();
+    opts.max_queued = result["max_queued"].as<size_t>();
+    if(result.count("dataset")) {
+        opts.dataset = result["dataset"].as<std::string>();
+    }
+    opts.publish = result["publish"].as<bool>();
+
+    // queries filter the resident flights themselves
+    std::string directory = "flight_concurr_arr_results";
+    if(opts.publish) {
+        assert_m(opts.dataset.has_value(), "--publish needs --dataset");
+        const std::vector<flight> flights = parse_flights_from_directory(directory, flight_constraints());
+        shared_dataset::publish(opts.dataset.value(), flights);
+        std::cout << "published " << flights.size() << " flights to " << opts.dataset.value() << std::endl;
+        return 0;
+    }
+
+    // with a dataset, every daemon mapping it shares one copy of the flights, and a reload maps
+    // whatever was published there last
+    std::optional<std::string> dataset = opts.dataset;
+    // client threads share these, so they outlive whichever of them lets go last
+    std::shared_ptr<resident_index> index = std::make_shared<resident_index>([directory, dataset]() {
+        flight_source source;
+        if(dataset.has_value()) {
+            source.mapped = std::make_shared<const shared_dataset>(dataset.value());
+        } else {
+            source.parsed = std::make_shared<const std::vector<flight> >(parse_flights_from_directory(directory, flight_constraints()));
+        }
+        return source;
+    });
+
+    sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    assert_m(opts.socket.size() < sizeof(addr.sun_path), "socket path too long: " + opts.socket);
+    std::strcpy(addr.sun_path, opts.socket.c_str());
+
+    const int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    assert_m(listener >= 0, "can't create socket");
+    unlink(opts.socket.c_str());
+    assert_m(bind(listener, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0, "can't bind " + opts.socket);
+    assert_m(listen(listener, 16) == 0, "can't listen on " + opts.socket);
+
+    std::shared_ptr<query_scheduler> scheduler = std::make_shared<query_scheduler>(opts.workers, opts.max_queued);
+    std::cout << "loaded " << index->size() << " flights, listening on " << opts.socket << std::endl;
+
+    // a thread per client, waiting on the scheduler most of the time, up to MAX_CLIENTS of them
+    std::shared_ptr<std::atomic<size_t> > clients = std::make_shared<std::atomic<size_t> >(0ul);
+    const std::string too_many = json({{"ok", false}, {"error", "too many clients"}}).dump() + "\n";
+    for(;;) {
+        const int fd = accept(listener, nullptr, nullptr);
+        if(fd < 0) {
+            continue;
+        }
+        if(*clients >= MAX_CLIENTS) {
+            send_all(fd, too_many);
+            close(fd);
+            continue;
+        }
+        ++*clients;
+        std::thread([index, scheduler, clients, fd]() {
+            serve(*index, *scheduler, fd);
+            close(fd);
+            --*clients;
+        }).detach();
+    }
+}
+#endif
@@ -2,78 +2,253 @@
 #include "parser.h"
 #include <fstream>
 
-const time_t boundary = 1734911999; // hardcode boundary for 2024-12-22 23:59:59 (Unix timestamp), can get end_ts from constraint?
-const time_t layover_time = 0;// hardcode layover time
+#include <omp.h>
+
+
+// itineraries don't connect past this without a departure date to go by, 2024-12-22 23:59:59
+constexpr time_t DEFAULT_BOUNDARY = 1734911999;
+
+// subtrees this close to the root with at least this many connections left become their own tasks
+constexpr size_t SPLIT_DEPTH = 3;
+constexpr size_t SPLIT_FANOUT = 4;
  
 // naive implementation of search
-template<>
-std::string flight_finder::search<OptLevel::NAIVE>() {
-
-    //std::ofstream outFile("debug.txt");
-    itinerary best_itinerary;
-
-    std::function<void(itinerary&, flight_id, int)> dfs = 
-    [&](itinerary& prev_itinerary, flight_id current_flight_id, int depth) {
-          
-        itinerary current_itinerary = prev_itinerary.add(current_flight_id, flights);
-        best_itinerary = itinerary::max(best_itinerary, current_itinerary, origin);
-        //outFile << "Depth: "<<depth<<std::endl;
-        //outFile << "Current flight: "<<std::endl<<flights[current_flight_id].serialize()<<std::endl;
-        //outFile << "Current itinerary: "<<std::endl<<current_itinerary.serialize(flights)<<std::endl;
-        //outFile << "Current best itinerary: "<<std::endl<<best_itinerary.serialize(flights)<<std::endl;
-        
+// exhaustive dfs over every itinerary, kept as the reference the other engines are checked against
+// past the deadline it stops exploring and returns the best it found so far, see partial()
+template <class Shape>
+std::string flight_finder::naive_kernel() {
+    const airport mandated = shape_origin<Shape>();
+    ran_out = false;
+
+    // end of the last departure date loaded, itineraries don't connect past it in local time
+    int last_day = NO_DAY;
+    for(const flight& f : flights.vec) {
+        last_day = std::max(last_day, f.day);
+    }
+    const time_t boundary = (last_day == NO_DAY) ? DEFAULT_BOUNDARY : (last_day + 1l) * 86400l - 1l;
+
+    // departures out of each airport, sorted by departure time, cancelled flights are never flown
+    std::vector<std::vector<flight_id> > departures(INVALID_AIRPORT + 1ul);
+    for(size_t i = 0; i < flights.size(); ++i) {
+        if(flights[flight_id(i)].cancelled) {
+            continue;
+        }
+        departures[flights[flight_id(i)].from].push_back(flight_id(i));
+    }
+    for(std::vector<flight_id>& out : departures) {
+        std::stable_sort(out.begin(), out.end(), [this](const flight_id& lhs, const flight_id& rhs) {
+            return flights[lhs].depart_ts < flights[rhs].depart_ts;
+        });
+    }
+
+    // [begin, end) into departures[flights[cur].to] of flights connecting from cur
+    auto connections = [this, &departures, boundary](const flight_id& cur) -> std::pair<size_t, size_t> {
+        const flight& current_flight = flights[cur];
+        const std::vector<flight_id>& out = departures[current_flight.to];
+
         // if the arrival time is beyond the boundary, then no more next connecting flight
-        if (flights[current_flight_id].arrive_ts + airport_tz[flights[current_flight_id].to] * 3600 > boundary) {
-            //outFile << "End of the day, no more departing flights"<<std::endl;
-            return;
+        if(current_flight.arrive_ts + airport_tz.at(current_flight.to) * 3600 > boundary) {
+            return {out.size(), out.size()};
         }
 
-        // explore all possible connecting flights
-        for (size_t next_flight_id = 0; next_flight_id < flights.size(); ++next_flight_id) {
-            const flight& current_flight = flights[current_flight_id];
-            const flight& next_flight = flights[next_flight_id];
+        // connection rules of the airport we landed at bound the departures we can make
+        const time_t mct = rules.min_connect[current_flight.to];
+        const time_t max_layover = rules.max_layover[current_flight.to];
+        auto comp = [this](const flight_id& lhs, const time_t& rhs) -> bool {
+            return flights[lhs].depart_ts < rhs;
+        };
+        auto begin = std::lower_bound(out.begin(), out.end(), current_flight.arrive_ts + mct, comp);
+        auto end = (max_layover == std::numeric_limits<time_t>::max()) ? out.end()
+            : std::upper_bound(begin, out.end(), current_flight.arrive_ts + max_layover, [this](const time_t& lhs, const flight_id& rhs) {
+                return lhs < flights[rhs].depart_ts;
+            });
 
-            // check if the next flight can connect to the current one
-            if (current_flight.to == next_flight.from && current_flight.arrive_ts + layover_time <= next_flight.depart_ts) {
-                //outFile << "Explore next flight: "<<flights[next_flight_id].serialize()<<std::endl;
-                dfs(current_itinerary, next_flight_id, depth + 1);
-                //outFile << "Back to last layer"<<std::endl<<std::endl;
-            }
+        return {static_cast<size_t>(begin - out.begin()), static_cast<size_t>(end - out.begin())};
+    };
+
+    // every flight starts an itinerary, unless all itineraries must start at origin
+    std::vector<flight_id> roots;
+    for(size_t i = 0; i < flights.size(); ++i) {
+        if(!flights[flight_id(i)].cancelled && (!Shape::has_origin || flights[flight_id(i)].from == mandated)) {
+            roots.push_back(flight_id(i));
         }
+    }
 
+    itinerary best_itinerary = Shape::has_origin ? itinerary(mandated) : itinerary();
+
+    // replaces best_itinerary with candidate if it is strictly better
+    auto consider = [&best_itinerary, mandated](const itinerary& candidate) {
+        if(&itinerary::better<Shape>(best_itinerary, candidate, mandated) == &candidate) {
+            best_itinerary = candidate;
+        }
     };
 
-    if (origin.has_value()) {
-        itinerary start_itinerary(origin.value());
-        // Find all flights starting from the origin
-        for(size_t i = 0; i < flights.size(); ++i){
-            if (flights[flight_id{i}].from == origin) {
-                itinerary current_itinerary(origin.value());
-                dfs(current_itinerary, flight_id{i}, 0);
+    if(!memoize) {
+        // each thread keeps its own best, combined once every task is done
+        struct alignas(64) thread_best {
+            itinerary best;
+        };
+        std::vector<thread_best> bests(omp_get_max_threads(), thread_best{best_itinerary});
+
+        // set by whichever task first sees the deadline pass, every task still queued then returns right away
+        std::atomic<bool> out_of_time = false;
+
+        // one frame per flight on the current itinerary, with the connections left to explore
+        struct frame {
+            flight_id id;
+            size_t next;
+            size_t end;
+        };
+
+        // exhaustive dfs of every itinerary starting with prefix
+        // subtrees near the top with many connections left are handed to the pool as their own tasks
+        auto explore = [this, &bests, &departures, &connections, &out_of_time, mandated](auto&& self, const std::vector<flight_id>& prefix) -> void {
+            if(out_of_time.load(std::memory_order_relaxed)) {
+                return;
+            }
+            itinerary& best = bests[omp_get_thread_num()].best;
+            std::vector<frame> stack;
+            itinerary current_itinerary;
+
+            // only the last flight of the prefix is expanded here, the rest belong to whoever spawned us
+            auto push = [this, &best, &stack, &current_itinerary, &connections, mandated](const flight_id& id, bool expand) {
+                current_itinerary.flight_ids.push_back(id);
+                current_itinerary.origin = flights[current_itinerary.flight_ids.front()].from;
+                current_itinerary.legs += flights[id].num_stops + 1u;
+                if(&itinerary::better<Shape>(best, current_itinerary, mandated) == &current_itinerary) {
+                    best = current_itinerary;
+                }
+
+                const auto [begin, end] = connections(id);
+                stack.push_back({id, expand ? begin : end, end});
+            };
+
+            for(size_t i = 0; i < prefix.size(); ++i) {
+                push(prefix[i], i + 1ul == prefix.size());
             }
+
+            for(size_t steps = 1; !stack.empty(); ++steps) {
+                if(steps % DEADLINE_CHECK == 0ul && (out_of_time.load(std::memory_order_relaxed) || deadline.expired())) {
+                    out_of_time = true;
+                    return;
+                }
+                frame& top = stack.back();
+
+                if(top.next == top.end) {
+                    // explored all connections, back to last layer
+                    current_itinerary.legs -= flights[top.id].num_stops + 1u;
+                    current_itinerary.flight_ids.pop_back();
+                    stack.pop_back();
+                    continue;
+                }
+
+                const bool split = stack.size() <= SPLIT_DEPTH && top.end - top.next >= SPLIT_FANOUT;
+                const flight_id next_id = departures[flights[top.id].to][top.next++];
+
+                if(split) {
+                    std::vector<flight_id> child = current_itinerary.flight_ids;
+                    child.push_back(next_id);
+
+                    #pragma omp task default(shared) firstprivate(child)
+                    self(self, child);
+                } else {
+                    push(next_id, true);
+                }
+            }
+        };
+
+        #pragma omp parallel
+        #pragma omp single
+        for(const flight_id& root : roots) {
+            if(out_of_time.load(std::memory_order_relaxed) || deadline.expired()) {
+                out_of_time = true;
+                break;
+            }
+            std::vector<flight_id> prefix{root};
+
+            #pragma omp task default(shared) firstprivate(prefix)
+            explore(explore, prefix);
         }
 
+        for(const thread_best& tb : bests) {
+            consider(tb.best);
+        }
+        ran_out = out_of_time;
     } else {
-        // If no origin is provided, iterate over all airports
-        #ifdef PROGRESS_PRINT
-        size_t progress = 0ul; // DEBUG
-        #endif // PROGRESS_PRINT
-        for (const auto& [airport_name, airport_node] : nodes) {
-            #ifdef PROGRESS_PRINT
-            std::cout << "searching airport " << progress++ << " of " << nodes.size() << std::endl; // DEBUG
-            #endif // PROGRESS_PRINT
-            itinerary start_itinerary = itinerary();
-            // Find all flights starting from the origin
-            for(size_t i = 0; i < flights.size(); ++i){
-                #ifdef PROGRESS_PRINT
-                std::cout << "searching flight " << i << " of " << flights.size() << std::endl;
-                #endif // PROGRESS_PRINT
-                if (flights[flight_id{i}].from == airport_name) {
-                    itinerary current_itinerary = itinerary();
-                    dfs(current_itinerary, flight_id{i}, 0);
+        // best continuation starting with each flight: total legs, and the flight after it if any
+        // every itinerary continuing from a flight shares everything before it, so this doesn't depend on how we got there
+        struct suffix {
+            uint legs = 0u;
+            size_t next = id_vec<flight_id, flight>::INVALID_ID;
+        };
+        enum class visit { NEW, EXPANDED, DONE };
+
+        std::vector<suffix> memo(flights.size());
+        std::vector<visit> state(flights.size(), visit::NEW);
+        std::vector<std::pair<flight_id, bool> > todo;
+
+        // post-order over the connection DAG below root, solving each flight once
+        // false if the deadline passed first, leaving flights expanded but not done
+        auto solve = [this, &departures, &connections, &memo, &state, &todo](const flight_id& root) -> bool {
+            todo.push_back({root, false});
+
+            for(size_t steps = 1; !todo.empty(); ++steps) {
+                if(steps % DEADLINE_CHECK == 0ul && deadline.expired()) {
+                    return false;
+                }
+                const auto [id, expanded] = todo.back();
+                todo.pop_back();
+
+                if(state[id.id] == visit::DONE) {
+                    continue;
                 }
+
+                const auto [begin, end] = connections(id);
+                const std::vector<flight_id>& out = departures[flights[id].to];
+
+                if(!expanded) {
+                    // time only moves forward along a connection, so a flight can't be reached again while expanded
+                    assert(state[id.id] == visit::NEW);
+                    state[id.id] = visit::EXPANDED;
+
+                    todo.push_back({id, true});
+                    for(size_t k = begin; k < end; ++k) {
+                        if(state[out[k].id] == visit::NEW) {
+                            todo.push_back({out[k], false});
+                        }
+                    }
+                    continue;
+                }
+
+                // more legs wins, tiebreak on the flight right after this one
+                suffix best{flights[id].num_stops + 1u};
+                for(size_t k = begin; k < end; ++k) {
+                    assert(state[out[k].id] == visit::DONE);
+                    const uint legs = flights[id].num_stops + 1u + memo[out[k].id].legs;
+
+                    if(legs > best.legs || (legs == best.legs && out[k].id > best.next)) {
+                        best = {legs, out[k].id};
+                    }
+                }
+
+                memo[id.id] = best;
+                state[id.id] = visit::DONE;
+            }
+            return true;
+        };
+
+        // roots solved before the deadline are exact, the rest are never looked at
+        for(const flight_id& root : roots) {
+            if(deadline.expired() || !solve(root)) {
+                ran_out = true;
+                break;
             }
-            //std::cout<< "Current best itinerary: "<<std::endl<<best_itinerary.serialize(flights)<<std::endl;
+
+            itinerary current_itinerary(flights[root].from);
+            for(size_t id = root.id; id != id_vec<flight_id, flight>::INVALID_ID; id = memo[id].next) {
+                current_itinerary = current_itinerary.add(flight_id(id), flights);
+            }
+            consider(current_itinerary);
         }
     }
 
@@ -108,7 +283,10 @@ int main(int argc, char **argv)
 
  
     // Initiate flight_finder
-    flight_finder ff(std::move(flights), constrs.origin);
+    flight_finder ff(std::move(flights), constrs);
+    if(constrs.deadline_ms.has_value()) {
+        ff.set_deadline(search_deadline::after(std::chrono::milliseconds(constrs.deadline_ms.value())));
+    }
 
     time_point<high_resolution_clock> start = high_resolution_clock::now();
     asm volatile ("" ::: "memory");
@@ -118,6 +296,9 @@ int main(int argc, char **argv)
 
     auto execution_ms = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
     std::cout << "execution time: " << execution_ms << "ms" << std::endl;
+    if(ff.partial()) {
+        std::cout << "ran out of time, best found so far" << std::endl;
+    }
 
     return 0;
 }
@@ -7,8 +7,19 @@ constexpr size_t NUM_DEP_THREADS = 16;
 constexpr size_t NUM_MAX_THREADS = 1;
 
 // parallel implementation of search
-template<>
-std::string flight_finder::search<OptLevel::PARALLEL>() {
+template <class Shape>
+std::string flight_finder::parallel_kernel() {
+    const airport mandated = shape_origin<Shape>();
+    assert_m(layout != OptLayout::STEP, "step layout is serial only");
+
+    // with a max layover the best connection isn't a single earlier state, sweep over time serially
+    if(rules.bounded()) {
+        bounded_kernel<Shape>();
+    }
+
+    // updates usually touch few states, propagate them serially
+    refresh_stale<Shape>();
+
     // to help track dependencies
     id_vec<flight_id, std::optional<flight_id> > deps_incoming(std::vector<std::optional<flight_id> >(flights.size(), std::nullopt));
     id_vec<flight_id, std::optional<flight_id> > deps_prev(std::vector<std::optional<flight_id> >(flights.size(), std::nullopt));
@@ -20,12 +31,12 @@ std::string flight_finder::search<OptLevel::PARALLEL>() {
         // returns optional including flight_id of incoming flight dependency, if it exists
         auto get_incoming = [this](size_t i, const flight_id& cur_id, const airport& depart_airport) -> std::optional<flight_id> {
             auto comp = [this](const flight_id& lhs, const time_t& rhs) -> bool {
-                return flights[lhs].arrive_ts < rhs;
+                return flights[lhs].arrive_ts <= rhs;
             };
             auto it = std::lower_bound(
                 nodes.at(depart_airport).arriving_flights.vec.begin(),
                 nodes.at(depart_airport).arriving_flights.vec.end(),
-                flights[cur_id].depart_ts,
+                flights[cur_id].depart_ts - rules.min_connect[depart_airport],
                 comp
             );
 
@@ -50,8 +61,9 @@ std::string flight_finder::search<OptLevel::PARALLEL>() {
             return std::make_optional(nodes.at(dest_airport).arriving_flights[flight_idx(cur_idx.id - 1ul)]);
         };
 
+        // states before num_built survived any flights added since the last search
         #pragma omp for
-        for(size_t i = 0; i < flights.size(); ++i) {
+        for(size_t i = num_built; i < flights.size(); ++i) {
             const flight_id cur_id = flight_id(i);
             const flight_idx cur_idx = flight_indices[cur_id];
             const airport dest_airport = flights[cur_id].to;
@@ -67,6 +79,9 @@ std::string flight_finder::search<OptLevel::PARALLEL>() {
     // to help track resolved dependencies
     std::vector<int> built(flights.size(), 0);
 
+    // past the deadline no more tasks are created, the ones already running finish before we give up
+    bool gave_up = false;
+
     #pragma omp parallel num_threads(NUM_MAX_THREADS)
     {
         // // analogous to one loop iteration in serial
@@ -85,16 +100,16 @@ std::string flight_finder::search<OptLevel::PARALLEL>() {
         // };
 
         // analogous to one loop iteration in serial
-        auto build_single_flight = [this, &built, &deps_incoming, &deps_prev](size_t i, const std::optional<flight_id>& incoming_id, const std::optional<flight_id>& prev_id) {
+        auto build_single_flight = [this, &built, &deps_incoming, &deps_prev, mandated](size_t i, const std::optional<flight_id>& incoming_id, const std::optional<flight_id>& prev_id) {
             const flight_id cur_id = flight_id(i);
-            const flight_idx cur_idx = flight_indices[cur_id];
             const airport dest_airport = flights[cur_id].to;
             const airport depart_airport = flights[cur_id].from;
 
-            const itinerary& incoming = incoming_id.has_value() ? nodes.at(depart_airport).opt_table[flight_indices[deps_incoming[cur_id].value()]] : itinerary(depart_airport);
-            const itinerary& prev     = prev_id.has_value() ? nodes.at(dest_airport).opt_table[flight_indices[deps_prev[cur_id].value()]] : itinerary(dest_airport);
+            const itinerary& incoming = incoming_id.has_value() ? opt_at(deps_incoming[cur_id].value()) : itinerary(depart_airport);
+            const itinerary& prev     = prev_id.has_value() ? opt_at(deps_prev[cur_id].value()) : itinerary(dest_airport);
 
-            nodes.at(dest_airport).opt_table[cur_idx] = itinerary::max(incoming.add(cur_id, flights), prev, origin);
+            // cancelled flights only carry the state before them forward
+            opt_at(cur_id) = flights[cur_id].cancelled ? prev : itinerary::better<Shape>(incoming.add(cur_id, flights), prev, mandated);
 
             assert(built[i] == 0);
             asm volatile("" ::: "memory");
@@ -104,10 +119,12 @@ std::string flight_finder::search<OptLevel::PARALLEL>() {
         };
 
         #pragma omp single nowait
-        for(size_t i = 0; i < flights.size(); ++i) {
+        for(size_t i = num_built; i < flights.size(); ++i) {
+            if((i - num_built) % DEADLINE_CHECK == 0ul && deadline.expired()) {
+                gave_up = true;
+                break;
+            }
             const flight_id cur_id = flight_id(i);
-            const airport dest_airport = flights[cur_id].to;
-            const airport depart_airport = flights[cur_id].from;
 
             const bool has_incoming = deps_incoming[cur_id].has_value();
             const bool has_prev     = deps_prev[cur_id].has_value();
@@ -131,8 +148,6 @@ std::string flight_finder::search<OptLevel::PARALLEL>() {
                     build_single_flight(i, deps_incoming[cur_id], deps_prev[cur_id]);
                     // build_single_flight(i, incoming.add(cur_id, flights), prev);
                 } else {
-                    const itinerary& incoming = nodes.at(depart_airport).opt_table[flight_indices[deps_incoming[cur_id].value()]];
-
                     const size_t dep_i = deps_incoming[cur_id].value().id;
 
                     assert_m(dep_i < flights.size(), std::to_string(dep_i));
@@ -147,8 +162,6 @@ std::string flight_finder::search<OptLevel::PARALLEL>() {
                 }
             } else {
                 if(has_prev) {
-                    const itinerary& prev     = nodes.at(dest_airport).opt_table[flight_indices[deps_prev[cur_id].value()]];
-
                     const size_t dep_p = deps_prev[cur_id].value().id;
 
                     assert_m(dep_p < flights.size(), std::to_string(dep_p));
@@ -173,14 +186,19 @@ std::string flight_finder::search<OptLevel::PARALLEL>() {
         }
     }
 
+    // states from num_built on are half built, the next search redoes them
+    if(gave_up) {
+        throw search_expired();
+    }
+    num_built = flights.size();
+
     time_point<high_resolution_clock> start_max_ts = high_resolution_clock::now();
 
-    std::optional<itinerary> best = origin.has_value() ? std::make_optional(itinerary(origin.value())) : std::nullopt;
+    std::optional<itinerary> best = Shape::has_origin ? std::make_optional(itinerary(mandated)) : std::nullopt;
     for(const auto& pair : nodes) {
-        const size_t opt_size = pair.second.opt_table.size();
-        if(opt_size) {
-            const itinerary candidate = pair.second.opt_table.vec.back();
-            best = best.has_value() ? itinerary::max(best.value(), candidate, origin) : candidate;
+        if(pair.second.arriving_flights.size()) {
+            const itinerary& candidate = opt_at(pair.second.arriving_flights.vec.back());
+            best = best.has_value() ? itinerary::better<Shape>(best.value(), candidate, mandated) : candidate;
         }
     }
     assert(best.has_value());
@@ -204,16 +222,38 @@ int main(int argc, char** argv) {
     std::string directory = "flight_concurr_arr_results";
     std::vector<flight> flights = parse_flights_from_directory(directory, constrs);
 
-    flight_finder ff(std::move(flights), constrs.origin);
+    flight_finder ff(std::move(flights), constrs);
+    std::cout << ff.stats().serialize();
     
-    time_point<high_resolution_clock> start = high_resolution_clock::now();
-    asm volatile("" ::: "memory");
-    std::cout << ff.search<OptLevel::PARALLEL>() << std::endl;
-    asm volatile("" ::: "memory");
-    time_point<high_resolution_clock> end = high_resolution_clock::now();
-
-    auto execution_ms = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
-    std::cout << "execution time: " << execution_ms << "ms" << std::endl;
+    // one deadline for the search and every lookup after it
+    if(constrs.deadline_ms.has_value()) {
+        ff.set_deadline(search_deadline::after(std::chrono::milliseconds(constrs.deadline_ms.value())));
+    }
+
+    try {
+        time_point<high_resolution_clock> start = high_resolution_clock::now();
+        asm volatile("" ::: "memory");
+        std::cout << ff.search<OptLevel::PARALLEL>() << std::endl;
+        asm volatile("" ::: "memory");
+        time_point<high_resolution_clock> end = high_resolution_clock::now();
+
+        auto execution_ms = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+        std::cout << "execution time: " << execution_ms << "ms" << std::endl;
+
+        // the finished opt tables answer every earlier end time too
+        for(time_t until : constrs.until) {
+            start = high_resolution_clock::now();
+            const std::string result = ff.search_ending_by<OptLevel::PARALLEL>(until);
+            end = high_resolution_clock::now();
+
+            auto lookup_us = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+            std::cout << "ending by " << until << ":" << std::endl << result << std::endl;
+            std::cout << "lookup time: " << lookup_us << "us" << std::endl;
+        }
+    } catch(const search_expired& e) {
+        std::cout << e.what() << std::endl;
+        return 1;
+    }
     
     return 0;
 }
@@ -3,6 +3,7 @@
 #include <fstream>
 #include <filesystem>
 #include <ctime>
+#include <chrono>
 #include "lib/src/json.hpp"
 
 using json = nlohmann::json;
@@ -46,6 +47,18 @@ cabin parse_cabin(const std::string &cabin_str)
     return cabin::ECONOMY;
 }
 
+// days since 1970-01-01 of a YYYY-MM-DD date
+int parse_day(const std::string &date_str)
+{
+    int y = 0;
+    unsigned m = 0, d = 0;
+    const int fields = std::sscanf(date_str.c_str(), "%d-%u-%u", &y, &m, &d);
+    assert_m(fields == 3, "bad date " + date_str);
+
+    const std::chrono::sys_days days = std::chrono::year_month_day{std::chrono::year{y}, std::chrono::month{m}, std::chrono::day{d}};
+    return days.time_since_epoch().count();
+}
+
 // Function to parse a single flight from JSON
 flight parse_flight(const json &flight_data)
 {
@@ -58,6 +71,9 @@ flight parse_flight(const json &flight_data)
     f.from = parse_airport(flight_data["search_parameters"]["departure_iota"].get<std::string>());
     f.to = parse_airport(flight_data["search_parameters"]["destination_iota"].get<std::string>());
 
+    // Parse the date this flight was searched for
+    f.day = parse_day(flight_data["search_parameters"]["departure_date"].get<std::string>());
+
     // Parse departure and arrival times (in Unix epoch format)
     f.depart_ts = flight_data["flight"]["unix_departure_time"].get<int64_t>();
     f.arrive_ts = flight_data["flight"]["unix_arrival_time"].get<int64_t>();
@@ -92,87 +108,119 @@ flight parse_flight(const json &flight_data)
     return f;
 }
 
+// whether a flight passes every filter in constraints, div_n aside
+bool admits(const flight &f, const flight_constraints &constraints)
+{
+    // Check airlines
+    if (constraints.airlines.has_value())
+    {
+        const auto &valid_airlines = constraints.airlines.value();
+        if (std::find(valid_airlines.begin(), valid_airlines.end(), f.al) == valid_airlines.end())
+        {
+            return false;
+        }
+    }
+
+    // Check if the flight matches the cabin constraint
+    if (constraints.fare_class.has_value() && f.fare_class != constraints.fare_class.value())
+    {
+        return false;
+    }
+
+    // Check if the flight matches the departure day constraint
+    if (constraints.departure_day.has_value() && f.day != constraints.departure_day.value())
+    {
+        return false;
+    }
+
+    // Check if the flight matches the start timestamp constraint
+    if (constraints.start_ts.has_value() && f.depart_ts < constraints.start_ts.value())
+    {
+        return false;
+    }
+
+    // Check if the flight matches the end timestamp constraint
+    if (constraints.end_ts.has_value() && f.arrive_ts > constraints.end_ts.value())
+    {
+        return false;
+    }
+
+    return true;
+}
+
+// fold one flight into a fingerprint, every field but the id
+static uint64_t fingerprint_flight(uint64_t h, const flight &f)
+{
+    const int64_t fields[] = {f.al, f.from, f.to, f.depart_ts, f.arrive_ts, f.num_stops, f.fare_class, f.price, f.day};
+    h = fnv1a(h, fields, sizeof(fields));
+    for (const std::string *str : {&f.depart_time, &f.arrive_time, &f.stops})
+    {
+        h = fnv1a(h, str->c_str(), str->size() + 1);
+    }
+    return h;
+}
+
+uint64_t flights_fingerprint(const std::vector<flight> &flights)
+{
+    uint64_t h = FNV_OFFSET;
+    for (const flight &f : flights)
+    {
+        h = fingerprint_flight(h, f);
+    }
+    return h;
+}
+
 // Function to parse all flights from JSON files in a directory
-std::vector<flight> parse_flights_from_directory(const std::string &dir_path, const flight_constraints constraints, bool debug_prints)
+std::vector<flight> parse_flights_from_directory(const std::string &dir_path, const flight_constraints constraints, bool debug_prints, uint64_t *fingerprint)
 {
+    uint64_t h = FNV_OFFSET;
     std::vector<flight> flights;
     size_t flight_id = 0;
-    size_t div_id = 0;
-    uint div_n = constraints.div_n.value_or(1);
+    flight_sampler sampler(constraints);
     size_t total_flights = 0;
     size_t removed_flights = 0;
     size_t included_flights = 0;
-    size_t valid_flights = 0;
 
-    // Iterate over all files in the directory
+    // files in name order, directory order differs between file systems and div_n samples by position
+    std::vector<std::filesystem::path> paths;
     for (const auto &entry : std::filesystem::directory_iterator(dir_path))
     {
         if (entry.is_regular_file() && entry.path().extension() == ".json")
         {
-            std::ifstream file(entry.path());
-            json root = json::parse(file);
+            paths.push_back(entry.path());
+        }
+    }
+    std::sort(paths.begin(), paths.end());
 
-            // Parse each flight in the flights_data array
-            for (const auto &flight_data : root["flights_data"])
+    // Iterate over all files in the directory
+    for (const std::filesystem::path &path : paths)
+    {
+        std::ifstream file(path);
+        json root = json::parse(file);
+
+        // Parse each flight in the flights_data array
+        for (const auto &flight_data : root["flights_data"])
+        {
+            flight f = parse_flight(flight_data);
+            f.id = flight_id;
+            total_flights++;
+            h = fingerprint_flight(h, f);
+
+            if (sampler.keep(f))
             {
-                flight f = parse_flight(flight_data);
-                f.id = flight_id;
-                total_flights++;
-
-                bool should_add_flight = true;
-
-                // Check airlines
-                if (constraints.airlines.has_value())
-                {
-                    const auto &valid_airlines = constraints.airlines.value();
-                    if (std::find(valid_airlines.begin(), valid_airlines.end(), f.al) == valid_airlines.end())
-                    {
-                        should_add_flight = false;
-                    }
-                }
-
-                // Check if the flight matches the cabin constraint
-                if (constraints.fare_class.has_value() && f.fare_class != constraints.fare_class.value())
-                {
-                    should_add_flight = false;
-                }
-
-                // Check if the flight matches the start timestamp constraint
-                if (constraints.start_ts.has_value() && f.depart_ts < constraints.start_ts.value())
-                {
-                    should_add_flight = false;
-                }
-
-                // Check if the flight matches the end timestamp constraint
-                if (constraints.end_ts.has_value() && f.arrive_ts > constraints.end_ts.value())
-                {
-                    should_add_flight = false;
-                }
-
-                if (should_add_flight)
-                {
-                    valid_flights++;
-
-                    // Check div_n constraint only if we should add the flight
-                    if (div_n <= 1 || div_id % div_n == 0)
-                    {
-                        flights.push_back(f);
-                        flight_id++; // Only incr after adding
-
-                        included_flights++;
-                    }
-                    else
-                        removed_flights++;
-
-                    div_id++;
-                }
-                else
-                    removed_flights++;
+                flights.push_back(f);
+                flight_id++; // Only incr after adding
+
+                included_flights++;
             }
+            else
+                removed_flights++;
         }
     }
 
     if(debug_prints) {
+        const size_t valid_flights = sampler.admitted();
+
         // Print flight parse metadata
         std::cout << "Total flights: " << total_flights << std::endl;
         std::cout << "Flights included: " << included_flights << std::endl;
@@ -194,5 +242,25 @@ std::vector<flight> parse_flights_from_directory(const std::string &dir_path, co
         }
     }
 
+    if (fingerprint)
+    {
+        *fingerprint = h;
+    }
+
     return flights;
 }
+
+std::vector<flight> filter_flights(const std::vector<flight> &all, const flight_constraints &constraints)
+{
+    // same selection as parse_flights_from_directory(), all is in the order it parsed them
+    return sample_flights(all.size(), constraints, [&all](size_t i) -> const flight &
+    {
+        return all[i];
+    });
+}
+
+std::vector<flight> parse_flights_for_day(const std::string &dir_path, flight_constraints constraints, int day)
+{
+    constraints.departure_day = day;
+    return parse_flights_from_directory(dir_path, constraints);
+}
@@ -4,6 +4,68 @@
 #include "common_data_types.h"
 #include "utils.h"
 
-std::vector<flight> parse_flights_from_directory(const std::string &dir_path, const flight_constraints constraints, bool debug_prints = false);
+// days since 1970-01-01 of a YYYY-MM-DD date
+int parse_day(const std::string &date_str);
+
+// whether a flight passes every filter in constraints, div_n aside
+bool admits(const flight &f, const flight_constraints &constraints);
+
+// picks the flights div_n keeps among those admits() passes, offered one at a time in parse order
+// every selection of flights under constraints goes through one, so they all pick the same flights
+class flight_sampler
+{
+public:
+    explicit flight_sampler(const flight_constraints &constraints) : constraints(constraints), div_n(constraints.div_n.value_or(1)) {}
+
+    // whether f is kept, call on every flight in order
+    bool keep(const flight &f)
+    {
+        if (!admits(f, constraints))
+        {
+            return false;
+        }
+        const bool kept = div_n <= 1 || div_id % div_n == 0;
+        div_id++;
+        return kept;
+    }
+
+    // flights admits() passed so far
+    size_t admitted() const { return div_id; }
+
+protected:
+    const flight_constraints &constraints;
+    uint div_n;
+    size_t div_id = 0;
+};
+
+// the flights a flight_sampler keeps among count of them, renumbered, source(i) giving the i-th
+template <class Source>
+std::vector<flight> sample_flights(size_t count, const flight_constraints &constraints, Source &&source)
+{
+    flight_sampler sampler(constraints);
+    std::vector<flight> flights;
+    for (size_t i = 0; i < count; ++i)
+    {
+        decltype(auto) f = source(i);
+        if (sampler.keep(f))
+        {
+            flights.push_back(std::forward<decltype(f)>(f));
+            flights.back().id = flights.size() - 1;
+        }
+    }
+    return flights;
+}
+
+// fingerprint, if given, gets flights_fingerprint() of every flight read, filtered out or not
+std::vector<flight> parse_flights_from_directory(const std::string &dir_path, const flight_constraints constraints, bool debug_prints = false, uint64_t *fingerprint = nullptr);
+
+// content hash of flights in order, ids aside, which changes whenever the flights would
+uint64_t flights_fingerprint(const std::vector<flight> &flights);
+
+// the flights parse_flights_from_directory() returns under constraints, picked from all it returned unfiltered
+std::vector<flight> filter_flights(const std::vector<flight> &all, const flight_constraints &constraints);
+
+// flights searched for one departure date, for use as a flight_window::loader
+std::vector<flight> parse_flights_for_day(const std::string &dir_path, flight_constraints constraints, int day);
 
 #endif // PARSER_H
\ No newline at end of file
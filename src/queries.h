@@ -0,0 +1,43 @@
+#ifndef QUERIES_H
+#define QUERIES_H
+
+#include "common_data_types.h"
+#include <sstream>
+
+// what one query line asks for, shared by everything answering query lines: serial.x --queries and flightfinderd
+
+// the search and --until lookups of a query line, as one batch for search(qs, ws)
+inline std::vector<search_query> forward_queries(const flight_constraints& constrs) {
+    std::vector<search_query> qs = {{.origin = constrs.origin}};
+    for(time_t until : constrs.until) {
+        qs.push_back({.origin = constrs.origin, .end_ts = until});
+    }
+    return qs;
+}
+
+// what a query line asks for, in the order its answer prints them
+inline std::vector<std::string> lookups_of(const flight_constraints& constrs) {
+    std::vector<std::string> lookups = {"search"};
+    for(time_t until : constrs.until) {
+        lookups.push_back("until " + std::to_string(until));
+    }
+    for(time_t since : constrs.since) {
+        lookups.push_back("since " + std::to_string(since));
+    }
+    return lookups;
+}
+
+// results of lookups_of(constrs) the way serial.x prints them
+inline std::string print_answer(const flight_constraints& constrs, const std::vector<std::string>& results) {
+    std::stringstream ss;
+    ss << results.front() << std::endl;
+    for(size_t j = 0; j < constrs.until.size(); ++j) {
+        ss << "ending by " << constrs.until[j] << ":" << std::endl << results[1ul + j] << std::endl;
+    }
+    for(size_t j = 0; j < constrs.since.size(); ++j) {
+        ss << "starting from " << constrs.since[j] << ":" << std::endl << results[1ul + constrs.until.size() + j] << std::endl;
+    }
+    return ss.str();
+}
+
+#endif // QUERIES_H
@@ -0,0 +1,118 @@
+#ifndef RESULT_CACHE_H
+#define RESULT_CACHE_H
+
+#include "common_data_types.h"
+#include <unistd.h>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <thread>
+
+/**
+ * @brief finished search results, in memory and optionally in a directory that outlives the process
+ * keys start with the fingerprint of the dataset they were searched on, so once the flights change
+ * every old entry misses instead of being served, and is left for whoever clears the directory
+ *
+ * one file per entry, named by a hash of its key, with the key on the first line to catch collisions
+ */
+class result_cache
+{
+public:
+    result_cache(std::optional<std::string> directory = std::nullopt) : dir(std::move(directory)) {
+        if(dir.has_value()) {
+            std::filesystem::create_directories(dir.value());
+        }
+    }
+
+    // key of one lookup under constrs on flights with the given fingerprint
+    // lookup names what was asked: "search", "until T" or "since T"
+    // layout and prefetch change how a search runs, not what it finds, so they don't split entries
+    static std::string key(uint64_t fingerprint, flight_constraints constrs, const std::string& lookup) {
+        constrs.layout = flight_constraints().layout;
+        constrs.prefetch = flight_constraints().prefetch;
+
+        std::stringstream ss;
+        ss << std::hex << std::setw(16) << std::setfill('0') << fingerprint << std::dec << "#" << index_key(constrs) << "#" << lookup;
+        return ss.str();
+    }
+
+    std::optional<std::string> get(const std::string& key) {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            auto it = entries.find(key);
+            if(it != entries.end()) {
+                return it->second;
+            }
+        }
+        if(!dir.has_value()) {
+            return std::nullopt;
+        }
+
+        std::ifstream in(path(key), std::ios::binary);
+        std::string stored;
+        if(!in.good() || !std::getline(in, stored) || stored != key) {
+            return std::nullopt;
+        }
+        std::string result((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+        std::lock_guard<std::mutex> guard(lock);
+        entries.try_emplace(key, result);
+        return result;
+    }
+
+    // written to a temporary file and renamed, so other processes sharing dir never read half an entry
+    void put(const std::string& key, const std::string& result) {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            entries.insert_or_assign(key, result);
+        }
+        if(!dir.has_value()) {
+            return;
+        }
+
+        const std::filesystem::path final_path = path(key);
+        // unique per process and thread, so concurrent writers of one entry never share a temp file
+        std::stringstream tmp;
+        tmp << final_path.string() << ".tmp" << getpid() << "." << std::hash<std::thread::id>()(std::this_thread::get_id());
+
+        std::ofstream out(tmp.str(), std::ios::binary | std::ios::trunc);
+        out << key << "\n" << result;
+        out.close();
+        assert_m(out.good(), "failed writing " + tmp.str());
+        std::filesystem::rename(tmp.str(), final_path);
+    }
+
+protected:
+    std::filesystem::path path(const std::string& key) const {
+        std::stringstream ss;
+        ss << std::hex << std::setw(16) << std::setfill('0') << fnv1a(FNV_OFFSET, key.data(), key.size());
+        return std::filesystem::path(dir.value()) / ss.str();
+    }
+
+    const std::optional<std::string> dir;
+
+    std::mutex lock;
+    std::unordered_map<std::string, std::string> entries;
+};
+
+/**
+ * @brief result of lookup under constrs, from cache if it has it, otherwise run() and remember it
+ * without a cache this is just run()
+ */
+template <class F>
+std::string cached(result_cache* cache, uint64_t fingerprint, const flight_constraints& constrs, const std::string& lookup, F&& run) {
+    if(cache == nullptr) {
+        return run();
+    }
+
+    const std::string key = result_cache::key(fingerprint, constrs, lookup);
+    if(std::optional<std::string> hit = cache->get(key)) {
+        return std::move(hit.value());
+    }
+
+    std::string result = run();
+    cache->put(key, result);
+    return result;
+}
+
+#endif // RESULT_CACHE_H
@@ -0,0 +1,263 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include "common_data_types.h"
+#include <condition_variable>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+/**
+ * @brief counts of what query_scheduler did with the queries handed to it
+ */
+struct scheduler_stats
+{
+    size_t submitted = 0; // queries handed to submit()
+    size_t coalesced = 0; // answered by a computation already queued or running for the same query
+    size_t batched = 0;   // swept together with another query instead of on their own
+    size_t rejected = 0;  // turned away with the queue full
+    size_t expired = 0;   // past their deadline before a worker got to them or their sweep finished
+};
+
+/**
+ * @brief runs const searches on shared finders from a fixed pool of workers, each with its own workspace
+ * a query identical to one queued or running shares its result, queued queries on the same finder with
+ * the same origin share one sweep, and once max_queued computations wait new queries are turned away
+ * instead of queueing up behind them, which keeps the wait of the admitted ones bounded
+ * a query past its deadline fails with search_expired, whether it was still queued, its sweep gave up, or
+ * the sweep it shared with later deadlines outran it
+ *
+ * finders must not be modified while queries on them are queued or running
+ */
+class query_scheduler
+{
+public:
+    query_scheduler(size_t workers, size_t capacity) : max_queued(capacity) {
+        for(size_t i = 0; i < workers; ++i) {
+            pool.emplace_back([this]() { work(); });
+        }
+    }
+
+    // queued queries are dropped, their futures throw std::future_error
+    ~query_scheduler() {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            stopping = true;
+            queue.clear();
+            in_flight.clear();
+        }
+        ready.notify_all();
+        for(std::thread& t : pool) {
+            t.join();
+        }
+    }
+
+    // result of q on ff, or nullopt if the queue is full
+    // finder_key tells finders apart, queries with equal finder keys must run on the same finder
+    // an identical query only shares its result if it doesn't give up before this one's deadline would
+    std::optional<std::shared_future<std::string> > submit(std::shared_ptr<const flight_finder> ff, const std::string& finder_key, const search_query& q, const search_deadline& deadline = search_deadline()) {
+        const std::string key = query_key(finder_key, q);
+
+        std::unique_lock<std::mutex> guard(lock);
+        ++counts.submitted;
+
+        auto it = in_flight.find(key);
+        if(it != in_flight.end() && outlasts(it->second->deadline, deadline)) {
+            ++counts.coalesced;
+            return it->second->result;
+        }
+        if(queue.size() >= max_queued) {
+            ++counts.rejected;
+            return std::nullopt;
+        }
+
+        std::shared_ptr<job> j = std::make_shared<job>();
+        j->ff = std::move(ff);
+        j->q = q;
+        j->key = key;
+        j->deadline = deadline;
+        j->result = j->done.get_future().share();
+        in_flight.insert_or_assign(key, j);
+        queue.push_back(j);
+
+        guard.unlock();
+        ready.notify_one();
+        return j->result;
+    }
+
+    scheduler_stats stats() const {
+        std::lock_guard<std::mutex> guard(lock);
+        return counts;
+    }
+
+protected:
+    struct job
+    {
+        std::shared_ptr<const flight_finder> ff;
+        search_query q;
+        std::string key;
+        search_deadline deadline;
+        std::promise<std::string> done;
+        std::shared_future<std::string> result;
+    };
+
+    // whether a computation running until a gives up no earlier than one running until b
+    // only plain time limits compare, a cancellation token belongs to whoever holds it
+    static bool outlasts(const search_deadline& a, const search_deadline& b) {
+        return !a.cancelled && (!a.at.has_value() || (b.at.has_value() && a.at.value() >= b.at.value()));
+    }
+
+    // a batch sweeps until its last query's deadline, one query's token only stops a sweep of its own
+    static search_deadline latest(const std::vector<std::shared_ptr<job> >& batch) {
+        if(batch.size() == 1ul) {
+            return batch.front()->deadline;
+        }
+        search_deadline out = batch.front()->deadline;
+        out.cancelled = nullptr;
+        for(const std::shared_ptr<job>& j : batch) {
+            if(!outlasts(out, j->deadline)) {
+                out.at = j->deadline.at;
+            }
+        }
+        return out;
+    }
+
+    // everything that decides a query's result
+    static std::string query_key(const std::string& finder_key, const search_query& q) {
+        std::stringstream ss;
+        ss << finder_key << "#";
+        if(q.origin.has_value()) {
+            ss << q.origin.value();
+        }
+        ss << "|";
+        if(q.end_ts.has_value()) {
+            ss << q.end_ts.value();
+        }
+        ss << "|";
+        if(q.dest.has_value()) {
+            ss << q.dest.value();
+        }
+        return ss.str();
+    }
+
+    // take the oldest queued query and every other one it can share a sweep with, run them, repeat
+    void work() {
+        search_workspace ws;
+        for(;;) {
+            std::vector<std::shared_ptr<job> > batch;
+            {
+                std::unique_lock<std::mutex> guard(lock);
+                ready.wait(guard, [this]() { return stopping || !queue.empty(); });
+                if(stopping) {
+                    return;
+                }
+
+                batch.push_back(std::move(queue.front()));
+                queue.pop_front();
+                for(auto it = queue.begin(); it != queue.end();) {
+                    if((*it)->ff == batch.front()->ff && (*it)->q.origin == batch.front()->q.origin) {
+                        batch.push_back(std::move(*it));
+                        it = queue.erase(it);
+                    } else {
+                        ++it;
+                    }
+                }
+                if(batch.size() > 1ul) {
+                    counts.batched += batch.size();
+                }
+            }
+
+            // queries that waited past their deadline fail without taking part in the sweep
+            std::vector<std::string> none;
+            expire(batch, none);
+            if(batch.empty()) {
+                continue;
+            }
+
+            std::vector<search_query> qs;
+            for(const std::shared_ptr<job>& j : batch) {
+                qs.push_back(j->q);
+            }
+            ws.deadline = latest(batch);
+
+            // a failed query fails the whole batch, rather than guessing which one did it
+            std::vector<std::string> results;
+            std::exception_ptr error;
+            try {
+                results = batch.front()->ff->search(qs, ws);
+            } catch(...) {
+                error = std::current_exception();
+            }
+
+            // the sweep ran until the latest deadline in the batch, queries whose own one passed meanwhile still fail
+            if(!error) {
+                expire(batch, results);
+            }
+            settle(batch, std::move(results), error);
+        }
+    }
+
+    // fail the jobs in batch past their deadline with search_expired and drop them, with their results if any
+    void expire(std::vector<std::shared_ptr<job> >& batch, std::vector<std::string>& results) {
+        std::vector<std::shared_ptr<job> > late, kept;
+        std::vector<std::string> kept_results;
+        for(size_t i = 0; i < batch.size(); ++i) {
+            if(batch[i]->deadline.expired()) {
+                late.push_back(std::move(batch[i]));
+            } else {
+                kept.push_back(std::move(batch[i]));
+                if(!results.empty()) {
+                    kept_results.push_back(std::move(results[i]));
+                }
+            }
+        }
+        batch = std::move(kept);
+        results = std::move(kept_results);
+        if(late.empty()) {
+            return;
+        }
+
+        // counted before the futures are ready, so whoever waits on them sees it
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            counts.expired += late.size();
+        }
+        settle(late, {}, std::make_exception_ptr(search_expired()));
+    }
+
+    // hand out results, or error to every job if set
+    void settle(const std::vector<std::shared_ptr<job> >& jobs, std::vector<std::string>&& results, std::exception_ptr error) {
+        // off the in flight list before the results are out, later submits start a new computation
+        // unless a query with a later deadline already took a job's place there
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            for(const std::shared_ptr<job>& j : jobs) {
+                auto it = in_flight.find(j->key);
+                if(it != in_flight.end() && it->second == j) {
+                    in_flight.erase(it);
+                }
+            }
+        }
+        for(size_t i = 0; i < jobs.size(); ++i) {
+            if(error) {
+                jobs[i]->done.set_exception(error);
+            } else {
+                jobs[i]->done.set_value(std::move(results[i]));
+            }
+        }
+    }
+
+    const size_t max_queued;
+
+    mutable std::mutex lock;
+    std::condition_variable ready;
+    std::deque<std::shared_ptr<job> > queue;
+    std::unordered_map<std::string, std::shared_ptr<job> > in_flight;
+    scheduler_stats counts;
+    bool stopping = false;
+
+    std::vector<std::thread> pool;
+};
+
+#endif // SCHEDULER_H
@@ -1,57 +1,57 @@
+// included by flightfinderd and the tests as well, once is enough
+#ifndef SERIAL_CPP
+#define SERIAL_CPP
+
 #include "common_data_types.h"
 #include "parser.h"
+#include "queries.h"
+#include "result_cache.h"
+#include <fstream>
+#include <map>
 
 // serial implementation of search
-template<>
-std::string flight_finder::search<OptLevel::SERIAL>() {
+template <class Shape>
+std::string flight_finder::serial_kernel() {
+    const airport mandated = shape_origin<Shape>();
     time_t arrival = 0ul;
 
-    for(size_t i = 0; i < flights.size(); ++i) {
-        const flight_id cur_id = flight_id(i);
-        const flight_idx cur_idx = flight_indices[cur_id];
-        const airport dest_airport = flights[cur_id].to;
-        const airport depart_airport = flights[cur_id].from;
-
-        // DEBUG
-        assert(flights[cur_id].arrive_ts >= arrival);
-        arrival = flights[cur_id].arrive_ts;
-
-        auto get_incoming = [this, &cur_id, &depart_airport]() -> itinerary {
-            auto comp = [this](const flight_id& lhs, const time_t& rhs) -> bool {
-                return flights[lhs].arrive_ts < rhs;
-            };
-            auto it = std::lower_bound(
-                nodes.at(depart_airport).arriving_flights.vec.begin(),
-                nodes.at(depart_airport).arriving_flights.vec.end(),
-                flights[cur_id].depart_ts,
-                comp
-            );
-
-            if(it == nodes.at(depart_airport).arriving_flights.vec.begin()) {
-                // no itinerary in time, use blank itinerary
-                return itinerary(depart_airport).add(cur_id, flights);
-            }
+    // stale states, a max layover and the dp itself are all up to the step sweep
+    if(layout == OptLayout::STEP) {
+        step_kernel<Shape>();
+        num_built = flights.size();
+        return best_landed<Shape>(std::numeric_limits<time_t>::max(), std::nullopt, mandated, &step_ws).serialize(flights);
+    }
 
-            flight_id best_id = *(it - 1);
-            assert(depart_airport == flights[best_id].to);
-            itinerary& prev = nodes.at(depart_airport).opt_table[flight_indices[best_id]];
-            
-            return prev.add(cur_id, flights);
-        };
+    // with a max layover the best connection isn't a prefix of the arrivals, sweep over time instead
+    if(rules.bounded()) {
+        bounded_kernel<Shape>();
+    }
 
-        itinerary incoming = get_incoming();
-        itinerary prev     = (cur_idx.id == 0ul) ? itinerary(dest_airport) : nodes.at(dest_airport).opt_table[flight_idx(cur_idx.id - 1ul)];
-        itinerary best     = itinerary::max(incoming, prev, origin);
+    // states before num_built survived any flights added since the last search, unless an update reached them
+    refresh_stale<Shape>();
 
-        nodes.at(dest_airport).opt_table[cur_idx] = std::move(best);
+    if(layout == OptLayout::ARRIVAL) {
+        arrival_order_kernel<Shape>();
+    } else {
+        for(size_t i = num_built; i < flights.size(); ++i) {
+            deadline.check(i - num_built);
+            const flight_id cur_id = flight_id(i);
+
+            // DEBUG
+            assert(flights[cur_id].arrive_ts >= arrival);
+            arrival = flights[cur_id].arrive_ts;
+
+            nodes.at(flights[cur_id].to).opt_table[flight_indices[cur_id]] = opt_state<Shape>(cur_id);
+        }
     }
+    // only once every state is in, a search that ran out of time redoes them all
+    num_built = flights.size();
 
-    std::optional<itinerary> best = origin.has_value() ? std::make_optional(itinerary(origin.value())) : std::nullopt;
+    std::optional<itinerary> best = Shape::has_origin ? std::make_optional(itinerary(mandated)) : std::nullopt;
     for(const auto& pair : nodes) {
-        const size_t opt_size = pair.second.opt_table.size();
-        if(opt_size) {
-            const itinerary candidate = pair.second.opt_table.vec.back();
-            best = best.has_value() ? itinerary::max(best.value(), candidate, origin) : candidate;
+        if(pair.second.arriving_flights.size()) {
+            const itinerary& candidate = opt_at(pair.second.arriving_flights.vec.back());
+            best = best.has_value() ? itinerary::better<Shape>(best.value(), candidate, mandated) : candidate;
         }
     }
     assert(best.has_value());
@@ -59,9 +59,433 @@ std::string flight_finder::search<OptLevel::SERIAL>() {
     return best.value().serialize(flights);
 }
 
+// queries with one origin from scratch into ws, every step of it reads the finder and writes ws only
+// the steps hold the state at every arrival, so one sweep answers any end time and destination
+template <class Shape>
+std::vector<itinerary> flight_finder::query_kernel(const std::vector<search_query>& qs, search_workspace& ws) const {
+    const airport mandated = Shape::has_origin ? qs.front().origin.value() : INVALID_AIRPORT;
+
+    for(std::vector<opt_step>& steps : ws.steps) {
+        steps.clear();
+    }
+    step_sweep<Shape>(ws, mandated, 0ul);
+
+    std::vector<itinerary> best;
+    for(const search_query& q : qs) {
+        best.push_back(best_landed<Shape>(q.end_ts.value_or(std::numeric_limits<time_t>::max()), q.dest, mandated, &ws));
+    }
+    return best;
+}
+
+// same dp as serial_kernel() over opt_flat, which is in arrival order
+// the per airport lookups go first, so the dp reads two earlier slots of one array and writes the next
+// those reads are scattered, so the dp runs in batches of prefetch flights, and while one batch runs
+// the states of the next one are prefetched, and the headers of the one after that
+template <class Shape>
+void flight_finder::arrival_order_kernel() {
+    const airport mandated = shape_origin<Shape>();
+    const size_t count = flights.size() - num_built;
+
+    // where each flight's prev and incoming states live, same as opt_state()
+    std::vector<std::optional<flight_id> > deps_prev(count);
+    std::vector<std::optional<flight_id> > deps_incoming(count);
+    auto comp = [this](const flight_id& lhs, const time_t& rhs) -> bool {
+        return flights[lhs].arrive_ts <= rhs;
+    };
+    for(size_t i = num_built; i < flights.size(); ++i) {
+        const flight& cur = flights[flight_id(i)];
+        const flight_idx cur_idx = flight_indices[flight_id(i)];
+        if(cur_idx.id) {
+            deps_prev[i - num_built] = nodes.at(cur.to).arriving_flights[flight_idx(cur_idx.id - 1ul)];
+        }
+
+        const id_vec<flight_idx, flight_id>& src = nodes.at(cur.from).arriving_flights;
+        auto it = std::lower_bound(src.vec.begin(), src.vec.end(), cur.depart_ts - rules.min_connect[cur.from], comp);
+        if(it != src.vec.begin()) {
+            deps_incoming[i - num_built] = *(it - 1);
+        }
+    }
+
+    // prefetch the itineraries flights [begin, end) read, or only their headers
+    auto fetch = [this, &deps_prev, &deps_incoming](size_t begin, size_t end, bool headers) {
+        for(size_t k = std::min(begin, deps_prev.size()); k < std::min(end, deps_prev.size()); ++k) {
+            for(const std::optional<flight_id>& dep : {deps_prev[k], deps_incoming[k]}) {
+                if(!dep.has_value()) {
+                    continue;
+                }
+                const itinerary& state = opt_flat[dep.value()];
+                if(headers) {
+                    __builtin_prefetch(&state);
+                } else {
+                    __builtin_prefetch(state.flight_ids.data());
+                }
+            }
+        }
+    };
+
+    const size_t batch = std::max<size_t>(prefetch, 1ul);
+    for(size_t begin = 0; begin < count; begin += batch) {
+        if(prefetch) {
+            fetch(begin + 2ul * batch, begin + 3ul * batch, true);
+            fetch(begin + batch, begin + 2ul * batch, false);
+        }
+
+        for(size_t i = num_built + begin; i < num_built + std::min(begin + batch, count); ++i) {
+            deadline.check(i - num_built);
+            const flight_id cur_id = flight_id(i);
+            const flight& cur = flights[cur_id];
+            const std::optional<flight_id>& prev_id = deps_prev[i - num_built];
+            const std::optional<flight_id>& incoming_id = deps_incoming[i - num_built];
+
+            const itinerary blank(cur.to);
+            const itinerary& prev = prev_id.has_value() ? opt_flat[prev_id.value()] : blank;
+            if(cur.cancelled) {
+                opt_flat[cur_id] = prev;
+                continue;
+            }
+
+            itinerary incoming = incoming_id.has_value() ? opt_flat[incoming_id.value()].add(cur_id, flights) : itinerary(cur.from).add(cur_id, flights);
+            opt_flat[cur_id] = itinerary::better<Shape>(incoming, prev, mandated);
+        }
+    }
+}
+
+// same dp as serial_kernel() keeping only the steps of each opt table, see step_sweep()
+// a flight only adds a step when it improves on its airport's state, lookups search steps by time
+template <class Shape>
+void flight_finder::step_kernel() {
+    // a stale state can change every step after it, so rebuild from the first one
+    // steps from num_built onwards were added before their ids moved or their states went stale
+    for(size_t i : stale) {
+        num_built = std::min(num_built, i);
+    }
+    stale.clear();
+    for(std::vector<opt_step>& steps : step_ws.steps) {
+        while(!steps.empty() && steps.back().id.id >= num_built) {
+            steps.pop_back();
+        }
+    }
+
+    step_ws.deadline = deadline;
+    step_sweep<Shape>(step_ws, shape_origin<Shape>(), num_built);
+}
+
+// serial reverse search, processes flights by departure time, decreasing
+// a continuation doesn't care where the itinerary started, so origin is only applied by the lookup
+template <class Shape>
+void flight_finder::reverse_kernel(const search_deadline& until) {
+    using any_origin = query_shape<false>;
+
+    std::vector<size_t> remaining(INVALID_AIRPORT + 1ul, 0ul);
+    for(auto& [ap, node] : nodes) {
+        node.cont_table.assign(node.departing_flights.size(), itinerary(ap));
+        remaining[ap] = node.departing_flights.size();
+    }
+
+    for(auto it = departure_order.rbegin(); it != departure_order.rend(); ++it) {
+        until.check(it - departure_order.rbegin());
+        const flight_id cur_id = *it;
+        const flight& cur = flights[cur_id];
+        airport_node& src = nodes.at(cur.from);
+
+        // departure_order restricted to one airport is that airport's departing_flights
+        const size_t pos = --remaining[cur.from];
+        assert(src.departing_flights[pos] == cur_id);
+
+        const itinerary blank(cur.from);
+        const itinerary& later = (pos + 1ul == src.cont_table.size()) ? blank : src.cont_table[pos + 1ul];
+        if(cur.cancelled) {
+            src.cont_table[pos] = later;
+            continue;
+        }
+
+        // best continuation we can make the connection to
+        const airport_node& dest = nodes.at(cur.to);
+        auto comp = [this](const flight_id& lhs, const time_t& rhs) -> bool {
+            return flights[lhs].depart_ts < rhs;
+        };
+        auto next = std::lower_bound(dest.departing_flights.begin(), dest.departing_flights.end(), cur.arrive_ts + rules.min_connect[cur.to], comp);
+
+        itinerary through = itinerary(cur.from).add(cur_id, flights);
+        if(next != dest.departing_flights.end()) {
+            through = through.then(dest.cont_table[next - dest.departing_flights.begin()], flights);
+        }
+
+        src.cont_table[pos] = itinerary::better<any_origin>(through, later, INVALID_AIRPORT);
+    }
+}
+
+template <class Shape>
+itinerary flight_finder::starting_from(time_t start_ts, const std::optional<time_t>& end_ts, const search_deadline& until) const {
+    const airport mandated = shape_origin<Shape>();
+
+    // a continuation with a max layover depends on when we land, so there is no running best to look up
+    if(rules.bounded()) {
+        return window_kernel<Shape>(start_ts, end_ts.value_or(std::numeric_limits<time_t>::max()), until);
+    }
+
+    // each table is a running best in reverse departure order, the first flight taking off in time holds the answer
+    std::optional<itinerary> best = Shape::has_origin ? std::make_optional(itinerary(mandated)) : std::nullopt;
+    for(const auto& [ap, node] : nodes) {
+        if(Shape::has_origin && ap != mandated) {
+            continue;
+        }
+
+        auto comp = [this](const flight_id& lhs, const time_t& rhs) -> bool {
+            return flights[lhs].depart_ts < rhs;
+        };
+        auto it = std::lower_bound(node.departing_flights.begin(), node.departing_flights.end(), start_ts, comp);
+        if(it == node.departing_flights.end()) {
+            continue;
+        }
+
+        const itinerary& candidate = node.cont_table[it - node.departing_flights.begin()];
+        best = best.has_value() ? itinerary::better<Shape>(best.value(), candidate, mandated) : candidate;
+    }
+    const itinerary from_start = best.value_or(itinerary());
+
+    auto inside = [this, start_ts, &end_ts](const itinerary& it) -> bool {
+        return it.flight_ids.empty()
+            || (flights[it.flight_ids.front()].depart_ts >= start_ts && flights[it.flight_ids.back()].arrive_ts <= end_ts.value());
+    };
+    if(!end_ts.has_value() || inside(from_start)) {
+        return from_start;
+    }
+
+    // the best from the other end also answers the window, if it takes off in time
+    if(num_built == flights.size() && stale.empty()) {
+        const itinerary to_end = best_ending_by<Shape>(end_ts.value(), std::nullopt);
+        if(inside(to_end)) {
+            return to_end;
+        }
+    }
+
+    return window_kernel<Shape>(start_ts, end_ts.value(), until);
+}
+
+// serial_kernel() over the flights inside [start_ts, end_ts] only, into scratch tables
+template <class Shape>
+itinerary flight_finder::window_kernel(time_t start_ts, time_t end_ts, const search_deadline& until) const {
+    const airport mandated = shape_origin<Shape>();
+
+    if(rules.bounded()) {
+        const id_vec<flight_id, itinerary> ends = bounded_sweep<Shape>([this, start_ts, end_ts](const flight_id& id) {
+            const flight& f = flights[id];
+            return !f.cancelled && f.depart_ts >= start_ts && f.arrive_ts <= end_ts;
+        }, mandated, until);
+
+        itinerary best = Shape::has_origin ? itinerary(mandated) : itinerary();
+        for(const itinerary& end : ends.vec) {
+            if(end.flight_ids.size()) {
+                best = itinerary::better<Shape>(best, end, mandated);
+            }
+        }
+        return best;
+    }
+
+    // per arrival airport, arrival time and opt state of each flight inside the window, in arrival order
+    std::vector<std::vector<std::pair<time_t, itinerary> > > states(INVALID_AIRPORT + 1ul);
+
+    // a flight taking off in time lands after start_ts
+    auto first = std::upper_bound(flights.vec.begin(), flights.vec.end(), start_ts, [](const time_t& lhs, const flight& rhs) {
+        return lhs < rhs.arrive_ts;
+    });
+    for(auto it = first; it != flights.vec.end() && it->arrive_ts <= end_ts; ++it) {
+        until.check(it - first);
+        const flight& cur = *it;
+        if(cur.cancelled || cur.depart_ts < start_ts) {
+            continue;
+        }
+        const flight_id cur_id = flight_id(cur.id);
+
+        const std::vector<std::pair<time_t, itinerary> >& in = states[cur.from];
+        auto connect = std::lower_bound(in.begin(), in.end(), cur.depart_ts - rules.min_connect[cur.from], [](const std::pair<time_t, itinerary>& lhs, const time_t& rhs) {
+            return lhs.first <= rhs;
+        });
+        const itinerary incoming = (connect == in.begin()) ? itinerary(cur.from).add(cur_id, flights) : (connect - 1)->second.add(cur_id, flights);
+
+        std::vector<std::pair<time_t, itinerary> >& out = states[cur.to];
+        const itinerary blank(cur.to);
+        const itinerary& prev = out.empty() ? blank : out.back().second;
+        itinerary next = itinerary::better<Shape>(incoming, prev, mandated);
+        out.emplace_back(cur.arrive_ts, std::move(next));
+    }
+
+    std::optional<itinerary> best = Shape::has_origin ? std::make_optional(itinerary(mandated)) : std::nullopt;
+    for(const std::vector<std::pair<time_t, itinerary> >& out : states) {
+        if(out.size()) {
+            best = best.has_value() ? itinerary::better<Shape>(best.value(), out.back().second, mandated) : out.back().second;
+        }
+    }
+
+    return best.value_or(itinerary());
+}
+
+// every query line against one set of flights, in parallel, answers in input order
+// each answer is what serial.x prints for those options, or the error they caused
+// lines with equal index_key() share a finder, and nothing modifies finders while the queries run
+// with a cache, lines it has every result for are answered from it and build no finder
+std::vector<std::string> answer_queries(const std::vector<flight>& all, const std::vector<std::string>& lines, result_cache* cache = nullptr) {
+    std::vector<std::string> out(lines.size());
+    std::vector<std::optional<flight_constraints> > constrs(lines.size());
+    const uint64_t fingerprint = cache ? flights_fingerprint(all) : 0ul;
+
+    // one finder per distinct key
+    std::map<std::string, size_t> finder_of;
+    std::vector<flight_constraints> finder_constrs;
+    std::vector<size_t> which(lines.size());
+    for(size_t i = 0; i < lines.size(); ++i) {
+        try {
+            constrs[i] = cli_line("serial", lines[i]);
+        } catch(const std::exception& e) {
+            out[i] = std::string("error: ") + e.what() + "\n";
+            continue;
+        }
+
+        if(cache) {
+            const std::vector<std::string> lookups = lookups_of(constrs[i].value());
+            std::vector<std::string> hits;
+            for(const std::string& lookup : lookups) {
+                std::optional<std::string> hit = cache->get(result_cache::key(fingerprint, constrs[i].value(), lookup));
+                if(!hit.has_value()) {
+                    break;
+                }
+                hits.push_back(std::move(hit.value()));
+            }
+            if(hits.size() == lookups.size()) {
+                out[i] = print_answer(constrs[i].value(), hits);
+                constrs[i].reset();
+                continue;
+            }
+        }
+
+        auto [it, inserted] = finder_of.try_emplace(index_key(constrs[i].value()), finder_constrs.size());
+        if(inserted) {
+            finder_constrs.push_back(constrs[i].value());
+        }
+        which[i] = it->second;
+    }
+
+    std::vector<std::unique_ptr<flight_finder> > finders(finder_constrs.size());
+    #pragma omp parallel for schedule(dynamic)
+    for(size_t k = 0; k < finders.size(); ++k) {
+        finders[k] = std::make_unique<flight_finder>(filter_flights(all, finder_constrs[k]), finder_constrs[k]);
+    }
+
+    // each line's lookups share one deadline, counted from here
+    std::vector<search_deadline> deadlines(lines.size());
+    for(size_t i = 0; i < lines.size(); ++i) {
+        if(constrs[i].has_value() && constrs[i].value().deadline_ms.has_value()) {
+            deadlines[i] = search_deadline::after(std::chrono::milliseconds(constrs[i].value().deadline_ms.value()));
+        }
+    }
+
+    // --since lookups read reverse tables, build them now so the queries only read them
+    // a line whose deadline the build outruns fails alone, the next line on that finder tries again
+    for(size_t i = 0; i < lines.size(); ++i) {
+        if(!constrs[i].has_value() || constrs[i].value().since.empty()) {
+            continue;
+        }
+        try {
+            finders[which[i]]->build_reverse(deadlines[i]);
+        } catch(const std::exception& e) {
+            out[i] = std::string("error: ") + e.what() + "\n";
+            constrs[i].reset();
+        }
+    }
+
+    #pragma omp parallel
+    {
+        search_workspace ws;
+
+        #pragma omp for schedule(dynamic)
+        for(size_t i = 0; i < lines.size(); ++i) {
+            if(!constrs[i].has_value()) {
+                continue;
+            }
+            const flight_constraints& c = constrs[i].value();
+            const flight_finder& ff = *finders[which[i]];
+
+            // the search and its --until lookups share one sweep, all of them within the line's own deadline
+            ws.deadline = deadlines[i];
+            try {
+                std::vector<std::string> results = ff.search(forward_queries(c), ws);
+                for(time_t since : c.since) {
+                    results.push_back(ff.lookup_starting_from(since, std::nullopt, ws.deadline));
+                }
+                out[i] = print_answer(c, results);
+
+                if(cache) {
+                    const std::vector<std::string> lookups = lookups_of(c);
+                    for(size_t j = 0; j < lookups.size(); ++j) {
+                        cache->put(result_cache::key(fingerprint, c, lookups[j]), results[j]);
+                    }
+                }
+            } catch(const std::exception& e) {
+                out[i] = std::string("error: ") + e.what() + "\n";
+            }
+        }
+    }
+
+    return out;
+}
+
 #ifndef REMOVE_MAIN_FUNC
+/**
+ * @brief serial.x options that aren't search constraints
+ */
+struct serial_options
+{
+    std::optional<std::string> query_file; // run every line of it as a query instead, in parallel
+    std::optional<std::string> cache_dir;  // directory of finished results, reused by later runs on the same flights
+};
+
 int main(int argc, char** argv) {
-    flight_constraints constrs = cli("serial", argc, argv);
+    cxxopts::Options options = search_options("serial");
+    options.add_options()
+        ("queries", "File of queries, one set of the search options per line", cxxopts::value<std::string>())
+        ("cache",   "Directory of finished results to reuse", cxxopts::value<std::string>());
+    const cxxopts::ParseResult result = parse_options(options, argc, argv);
+    flight_constraints constrs = search_constraints(result);
+
+    serial_options opts;
+    if(result.count("queries")) {
+        opts.query_file = result["queries"].as<std::string>();
+    }
+    if(result.count("cache")) {
+        opts.cache_dir = result["cache"].as<std::string>();
+    }
+
+    // a query file brings its own options, one set per line
+    if(opts.query_file.has_value()) {
+        std::ifstream in(opts.query_file.value());
+        assert_m(in.good(), "can't open " + opts.query_file.value());
+        std::vector<std::string> lines;
+        for(std::string line; std::getline(in, line);) {
+            if(!line.empty()) {
+                lines.push_back(line);
+            }
+        }
+
+        std::cout << "running serial on " << lines.size() << " queries" << std::endl;
+
+        std::string directory = "flight_concurr_arr_results";
+        const std::vector<flight> all = parse_flights_from_directory(directory, flight_constraints());
+        std::unique_ptr<result_cache> cache = opts.cache_dir.has_value() ? std::make_unique<result_cache>(opts.cache_dir) : nullptr;
+
+        time_point<high_resolution_clock> start = high_resolution_clock::now();
+        const std::vector<std::string> answers = answer_queries(all, lines, cache.get());
+        time_point<high_resolution_clock> end = high_resolution_clock::now();
+
+        for(size_t i = 0; i < lines.size(); ++i) {
+            std::cout << "query " << i + 1ul << ": " << lines[i] << std::endl << answers[i] << std::endl;
+        }
+
+        auto execution_ms = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+        std::cout << "execution time: " << execution_ms << "ms" << std::endl;
+
+        return 0;
+    }
 
     std::cout << "running serial" << std::endl;
 
@@ -69,19 +493,70 @@ int main(int argc, char** argv) {
     // std::string directory = "naive_test/top_5_airports_flight_arrival_results";
     // std::string directory = "flight_correct_ts_arrival";
     std::string directory = "flight_concurr_arr_results";
-    std::vector<flight> flights = parse_flights_from_directory(directory, constrs);
+    uint64_t fingerprint = 0;
+    std::vector<flight> flights = parse_flights_from_directory(directory, constrs, false, &fingerprint);
 
-    flight_finder ff(std::move(flights), constrs.origin);
+    // a cached result comes back without searching, the flights parsed with the same fingerprint
+    std::unique_ptr<result_cache> cache = opts.cache_dir.has_value() ? std::make_unique<result_cache>(opts.cache_dir) : nullptr;
+
+    // built on the first cache miss, a run the cache answers entirely never builds it
+    std::optional<flight_finder> built;
+    auto finder = [&]() -> flight_finder& {
+        if(!built.has_value()) {
+            built.emplace(std::move(flights), constrs);
+            std::cout << built->stats().serialize();
+
+            // one deadline for the search and every lookup after it
+            if(constrs.deadline_ms.has_value()) {
+                built->set_deadline(search_deadline::after(std::chrono::milliseconds(constrs.deadline_ms.value())));
+            }
+        }
+        return built.value();
+    };
 
-    time_point<high_resolution_clock> start = high_resolution_clock::now();
-    asm volatile ("" ::: "memory");
-    std::cout << ff.search<OptLevel::SERIAL>() << std::endl;
-    asm volatile ("" ::: "memory");
-    time_point<high_resolution_clock> end = high_resolution_clock::now();
+    try {
+        time_point<high_resolution_clock> start = high_resolution_clock::now();
+        asm volatile ("" ::: "memory");
+        std::cout << cached(cache.get(), fingerprint, constrs, "search", [&]() {
+            return finder().search<OptLevel::SERIAL>();
+        }) << std::endl;
+        asm volatile ("" ::: "memory");
+        time_point<high_resolution_clock> end = high_resolution_clock::now();
 
-    auto execution_ms = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
-    std::cout << "execution time: " << execution_ms << "ms" << std::endl;
+        auto execution_ms = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+        std::cout << "execution time: " << execution_ms << "ms" << std::endl;
+
+        // the finished opt tables answer every earlier end time too
+        for(size_t j = 0; j < constrs.until.size(); ++j) {
+            const time_t until = constrs.until[j];
+            start = high_resolution_clock::now();
+            const std::string result = cached(cache.get(), fingerprint, constrs, "until " + std::to_string(until), [&]() {
+                return finder().search_ending_by<OptLevel::SERIAL>(until);
+            });
+            end = high_resolution_clock::now();
+
+            auto lookup_us = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+            std::cout << "ending by " << until << ":" << std::endl << result << std::endl;
+            std::cout << "lookup time: " << lookup_us << "us" << std::endl;
+        }
+
+        // so do reverse tables for every start time
+        for(time_t since : constrs.since) {
+            start = high_resolution_clock::now();
+            const std::string result = cached(cache.get(), fingerprint, constrs, "since " + std::to_string(since), [&]() { return finder().search_starting_from(since); });
+            end = high_resolution_clock::now();
+
+            auto lookup_us = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+            std::cout << "starting from " << since << ":" << std::endl << result << std::endl;
+            std::cout << "lookup time: " << lookup_us << "us" << std::endl;
+        }
+    } catch(const search_expired& e) {
+        std::cout << e.what() << std::endl;
+        return 1;
+    }
     
     return 0;
 }
-#endif // REMOVE_MAIN_FUNC
\ No newline at end of file
+#endif // REMOVE_MAIN_FUNC
+
+#endif // SERIAL_CPP
@@ -0,0 +1,331 @@
+#ifndef SHARD_H
+#define SHARD_H
+
+#include "common_data_types.h"
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <array>
+#include <cstring>
+#include <thread>
+
+/**
+ * @brief one batch of queries on its way through the shards, see sharded_search()
+ */
+struct shard_job
+{
+    std::vector<search_query> qs;                     // same origin, as for one search(qs, ws)
+    std::vector<std::optional<std::string> > answers; // filled in by the shard each query ends in
+    search_workspace ws;                              // steps later shards still look up
+};
+
+// messages are length prefixed, values in host byte order, which is all processes on one machine need
+namespace shard_wire
+{
+
+template <class T>
+void put(std::string& buf, const T& value) {
+    buf.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <class T>
+T take(const std::string& buf, size_t& at) {
+    assert_m(at + sizeof(T) <= buf.size(), "shard message ended early");
+    T value;
+    std::memcpy(&value, buf.data() + at, sizeof(T));
+    at += sizeof(T);
+    return value;
+}
+
+template <class T>
+void put(std::string& buf, const std::optional<T>& value) {
+    put(buf, value.has_value());
+    if(value.has_value()) {
+        put(buf, value.value());
+    }
+}
+
+template <class T>
+std::optional<T> take_optional(const std::string& buf, size_t& at) {
+    return take<bool>(buf, at) ? std::make_optional(take<T>(buf, at)) : std::nullopt;
+}
+
+inline std::string encode(const shard_job& job) {
+    std::string buf;
+    put(buf, job.qs.size());
+    for(size_t i = 0; i < job.qs.size(); ++i) {
+        put(buf, job.qs[i].origin);
+        put(buf, job.qs[i].end_ts);
+        put(buf, job.qs[i].dest);
+        put(buf, job.answers[i].has_value());
+        if(job.answers[i].has_value()) {
+            put(buf, job.answers[i].value().size());
+            buf.append(job.answers[i].value());
+        }
+    }
+
+    put(buf, job.ws.steps.size());
+    for(const std::vector<opt_step>& steps : job.ws.steps) {
+        put(buf, steps.size());
+        for(const opt_step& step : steps) {
+            put(buf, step.id.id);
+            put(buf, step.arrive_ts);
+            put(buf, step.best.origin);
+            put(buf, step.best.legs);
+            put(buf, step.best.flight_ids.size());
+            buf.append(reinterpret_cast<const char*>(step.best.flight_ids.data()), step.best.flight_ids.size() * sizeof(flight_id));
+        }
+    }
+    return buf;
+}
+
+inline shard_job decode(const std::string& buf) {
+    shard_job job;
+    size_t at = 0;
+    const size_t num_qs = take<size_t>(buf, at);
+    for(size_t i = 0; i < num_qs; ++i) {
+        search_query q;
+        q.origin = take_optional<airport>(buf, at);
+        q.end_ts = take_optional<time_t>(buf, at);
+        q.dest = take_optional<airport>(buf, at);
+        job.qs.push_back(q);
+
+        job.answers.emplace_back();
+        if(take<bool>(buf, at)) {
+            const size_t len = take<size_t>(buf, at);
+            assert_m(at + len <= buf.size(), "shard message ended early");
+            job.answers.back() = buf.substr(at, len);
+            at += len;
+        }
+    }
+
+    job.ws.steps.resize(take<size_t>(buf, at));
+    for(std::vector<opt_step>& steps : job.ws.steps) {
+        steps.resize(take<size_t>(buf, at), opt_step{flight_id(0), 0, itinerary()});
+        for(opt_step& step : steps) {
+            step.id = flight_id(take<size_t>(buf, at));
+            step.arrive_ts = take<time_t>(buf, at);
+            step.best.origin = take<airport>(buf, at);
+            step.best.legs = take<uint>(buf, at);
+            const size_t len = take<size_t>(buf, at);
+            for(size_t k = 0; k < len; ++k) {
+                step.best.flight_ids.push_back(flight_id(take<size_t>(buf, at)));
+            }
+        }
+    }
+    return job;
+}
+
+// false once the other end is gone
+inline bool send_message(int fd, const std::string& msg) {
+    std::string framed;
+    put(framed, msg.size());
+    framed.append(msg);
+    for(size_t sent = 0; sent < framed.size();) {
+        const ssize_t n = send(fd, framed.data() + sent, framed.size() - sent, MSG_NOSIGNAL);
+        if(n <= 0) {
+            return false;
+        }
+        sent += n;
+    }
+    return true;
+}
+
+// false once the other end hung up between messages
+inline bool receive_message(int fd, std::string& msg) {
+    auto fill = [fd](char* out, size_t len) -> bool {
+        for(size_t got = 0; got < len;) {
+            const ssize_t n = recv(fd, out + got, len - got, 0);
+            if(n <= 0) {
+                return false;
+            }
+            got += n;
+        }
+        return true;
+    };
+
+    size_t len;
+    if(!fill(reinterpret_cast<char*>(&len), sizeof(len))) {
+        return false;
+    }
+    msg.resize(len);
+    assert_m(fill(msg.data(), len), "shard message cut short");
+    return true;
+}
+
+} // namespace shard_wire
+
+// one shard: sweep flights [from, to) for every job coming in, answer the queries ending before the
+// next shard's flights land, and pass on only the steps a later flight or query can still look up
+inline void shard_worker(const flight_finder& ff, size_t from, size_t to, int in, int out) {
+    const bool last = to == ff.size();
+    const time_t next_arrival = last ? std::numeric_limits<time_t>::max() : ff.arrival(to);
+    const time_t horizon = ff.lookup_horizon(to);
+
+    for(std::string msg; shard_wire::receive_message(in, msg);) {
+        shard_job job = shard_wire::decode(msg);
+
+        // once every query is answered, the shards after it only pass the job on
+        if(std::any_of(job.answers.begin(), job.answers.end(), [](const auto& a) { return !a.has_value(); })) {
+            ff.sweep_range(job.ws, job.qs.front().origin, from, to);
+            for(size_t i = 0; i < job.qs.size(); ++i) {
+                if(!job.answers[i].has_value() && (last || job.qs[i].end_ts.value_or(next_arrival) < next_arrival)) {
+                    job.answers[i] = ff.landed(job.qs[i], job.ws);
+                }
+            }
+            flight_finder::trim_steps(job.ws, horizon);
+        }
+
+        if(!shard_wire::send_message(out, shard_wire::encode(job))) {
+            return;
+        }
+    }
+}
+
+// most worker processes sharded_search() forks, each holds two sockets and a copy of the finder
+constexpr size_t MAX_SHARDS = 8;
+
+/**
+ * @brief sockets and worker processes of one sharded_search(), whatever is still open or running when it
+ * goes out of scope is shut down, so a failure anywhere leaks neither fds nor processes nor a running feeder
+ */
+struct shard_pipeline
+{
+    std::vector<std::array<int, 2> > links; // links[k] feeds shard k, links.back() comes back, -1 once closed
+    std::vector<pid_t> workers;
+    std::thread feeder;
+
+    ~shard_pipeline() {
+        finish();
+    }
+
+    void close_fd(int& fd) {
+        if(fd >= 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+
+    // stop feeding, close every link and wait for the workers, true if they all exited cleanly
+    bool finish() {
+        if(feeder.joinable()) {
+            // the last shard's output is gone, so it exits, and so on back to the first, failing the feeder's send
+            if(!links.empty() && links.back()[1] >= 0) {
+                shutdown(links.back()[1], SHUT_RDWR);
+            }
+            feeder.join();
+        }
+        for(std::array<int, 2>& link : links) {
+            close_fd(link[0]);
+            close_fd(link[1]);
+        }
+
+        bool ok = true;
+        for(pid_t pid : workers) {
+            int status = 0;
+            waitpid(pid, &status, 0);
+            ok &= WIFEXITED(status) && WEXITSTATUS(status) == 0;
+        }
+        workers.clear();
+        return ok;
+    }
+};
+
+/**
+ * @brief answers to each batch of queries in jobs, as search(jobs[i], ws) gives them, with the flights split
+ * by arrival time into shards ranges and each range swept by its own worker process
+ * the workers are forked from this one and form a pipeline over unix sockets: a batch's steps go through
+ * every shard in time order, and each shard drops the steps no later flight connects from before
+ * passing them on. while a batch is in one shard the next one is already in the shard before
+ *
+ * one batch still goes through every shard in turn, so it takes at least as long as it would serially,
+ * plus the messages, and every worker holds the whole finder, so memory isn't split either. it could only
+ * pay off as throughput over many batches, which nothing has measured yet, so no binary uses it
+ * shards are capped at MAX_SHARDS and the number of flights
+ *
+ * shards share nothing but the finder they were forked with, every step they exchange goes over
+ * their sockets, so shards that build the finder from the same flights themselves could run elsewhere
+ * serial only, and not with a max layover, where a state can connect to any flight after it
+ */
+inline std::vector<std::vector<std::string> > sharded_search(const flight_finder& ff, const std::vector<std::vector<search_query> >& jobs, size_t shards) {
+    for(const std::vector<search_query>& qs : jobs) {
+        assert_m(!qs.empty(), "no queries");
+        for(const search_query& q : qs) {
+            assert_m(q.origin == qs.front().origin, "queries in one sweep need the same origin");
+        }
+    }
+    shards = std::max<size_t>(1ul, std::min({shards, ff.size(), MAX_SHARDS}));
+
+    // links[k] feeds shard k, links[shards] comes back here
+    shard_pipeline pipe;
+    for(size_t k = 0; k <= shards; ++k) {
+        std::array<int, 2> link;
+        assert_m(socketpair(AF_UNIX, SOCK_STREAM, 0, link.data()) == 0, "can't create shard socket");
+        pipe.links.push_back(link);
+    }
+    std::vector<std::array<int, 2> >& links = pipe.links;
+
+    // equal numbers of flights per shard
+    for(size_t k = 0; k < shards; ++k) {
+        const pid_t pid = fork();
+        assert_m(pid >= 0, "can't fork shard " + std::to_string(k));
+        if(pid == 0) {
+            for(size_t j = 0; j < links.size(); ++j) {
+                if(j != k) {
+                    close(links[j][1]);
+                }
+                if(j != k + 1ul) {
+                    close(links[j][0]);
+                }
+            }
+            try {
+                shard_worker(ff, k * ff.size() / shards, (k + 1ul) * ff.size() / shards, links[k][1], links[k + 1ul][0]);
+            } catch(const std::exception& e) {
+                std::cerr << "shard " << k << " failed: " << e.what() << std::endl;
+                _exit(1);
+            }
+            _exit(0);
+        }
+        pipe.workers.push_back(pid);
+    }
+
+    const int first = links.front()[0];
+    const int back = links.back()[1];
+    for(size_t j = 0; j < links.size(); ++j) {
+        if(j != 0ul) {
+            pipe.close_fd(links[j][0]);
+        }
+        if(j != shards) {
+            pipe.close_fd(links[j][1]);
+        }
+    }
+
+    // feed jobs on another thread, so the shards never wait on us to read their results
+    pipe.feeder = std::thread([&jobs, first]() {
+        for(const std::vector<search_query>& qs : jobs) {
+            shard_job job{qs, std::vector<std::optional<std::string> >(qs.size()), search_workspace()};
+            if(!shard_wire::send_message(first, shard_wire::encode(job))) {
+                break;
+            }
+        }
+        shutdown(first, SHUT_WR);
+    });
+
+    std::vector<std::vector<std::string> > out;
+    std::string msg;
+    while(out.size() < jobs.size() && shard_wire::receive_message(back, msg)) {
+        shard_job job = shard_wire::decode(msg);
+        out.emplace_back();
+        for(std::optional<std::string>& answer : job.answers) {
+            assert_m(answer.has_value(), "a batch came back unanswered");
+            out.back().push_back(std::move(answer.value()));
+        }
+    }
+
+    const bool ok = pipe.finish();
+    assert_m(ok && out.size() == jobs.size(), "a shard failed, " + std::to_string(out.size()) + " of " + std::to_string(jobs.size()) + " batches answered");
+
+    return out;
+}
+
+#endif // SHARD_H
@@ -0,0 +1,112 @@
+#ifndef SHARED_DATASET_H
+#define SHARED_DATASET_H
+
+#include "parser.h"
+#include "stream_record.h"
+#include <filesystem>
+#include <fstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+// file layout: one dataset_header, then header.count stream_records in the order they were parsed,
+// so a record's position is the id parse_flights_from_directory() gave it
+constexpr char DATASET_MAGIC[8] = {'F', 'L', 'T', 'S', 'H', 'R', 'D', '1'};
+
+struct dataset_header
+{
+    char magic[8];
+    uint64_t count;
+    uint64_t fingerprint; // flights_fingerprint() of the flights
+};
+
+/**
+ * @brief parsed flights in one file that any number of processes map read only
+ * under /dev/shm the file is shared memory, every process mapping it reads the same pages, and
+ * attaching costs a page table rather than a parse
+ *
+ * publishing a new dataset replaces the file, processes that mapped the old one keep reading it
+ * until they let go of it
+ */
+class shared_dataset
+{
+public:
+    // write flights to path for workers to map, the old file stays in place until the new one is complete
+    static void publish(const std::string& path, const std::vector<flight>& flights) {
+        dataset_header header;
+        std::memcpy(header.magic, DATASET_MAGIC, sizeof(DATASET_MAGIC));
+        header.count = flights.size();
+        header.fingerprint = flights_fingerprint(flights);
+
+        const std::string tmp = path + ".tmp" + std::to_string(getpid());
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        assert_m(out.good(), "can't open " + tmp);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        for(const flight& f : flights) {
+            const stream_record r = to_record(f);
+            out.write(reinterpret_cast<const char*>(&r), sizeof(r));
+        }
+        out.close();
+        assert_m(out.good(), "failed writing " + tmp);
+        std::filesystem::rename(tmp, path);
+    }
+
+    // map the dataset at path, read only
+    explicit shared_dataset(const std::string& path) {
+        const int fd = open(path.c_str(), O_RDONLY);
+        assert_m(fd >= 0, "can't open " + path);
+
+        struct stat st;
+        const bool sized = fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) >= sizeof(dataset_header);
+        if(sized) {
+            length = st.st_size;
+            base = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+        }
+        close(fd);
+        assert_m(sized && base != MAP_FAILED, "can't map " + path);
+
+        const dataset_header& h = header();
+        if(std::memcmp(h.magic, DATASET_MAGIC, sizeof(DATASET_MAGIC)) != 0 || length != sizeof(dataset_header) + h.count * sizeof(stream_record)) {
+            munmap(base, length);
+            assert_m(false, path + " is not a dataset file");
+        }
+    }
+
+    ~shared_dataset() {
+        munmap(base, length);
+    }
+
+    shared_dataset(const shared_dataset&) = delete;
+    shared_dataset& operator=(const shared_dataset&) = delete;
+
+    size_t size() const { return header().count; }
+    uint64_t fingerprint() const { return header().fingerprint; }
+
+    flight at(size_t id) const {
+        assert_m(id < size(), std::to_string(id) + " attempted, size: " + std::to_string(size()));
+        return to_flight(records()[id], id);
+    }
+
+    // the flights filter_flights() picks from every flight under constraints, ids included
+    // sampled by sample_flights() as filter_flights() is, only the picked ones are kept
+    std::vector<flight> select(const flight_constraints& constraints) const {
+        return sample_flights(size(), constraints, [this](size_t i) {
+            return to_flight(records()[i], i);
+        });
+    }
+
+protected:
+    const dataset_header& header() const {
+        return *static_cast<const dataset_header*>(base);
+    }
+
+    const stream_record* records() const {
+        return reinterpret_cast<const stream_record*>(static_cast<const char*>(base) + sizeof(dataset_header));
+    }
+
+    void* base = MAP_FAILED;
+    size_t length = 0;
+};
+
+#endif // SHARED_DATASET_H
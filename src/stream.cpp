@@ -0,0 +1,252 @@
+#include "common_data_types.h"
+#include "parser.h"
+#include "stream_record.h"
+#include <fstream>
+#include <deque>
+#include <cstring>
+
+// file layout: one stream_header, then header.count stream_records sorted by arrival time
+// flights arriving at the same time keep their input order, same as flight_finder
+constexpr char STREAM_MAGIC[8] = {'F', 'L', 'T', 'S', 'T', 'R', 'M', '1'};
+
+struct stream_header
+{
+    char magic[8];
+    uint64_t count;
+    int64_t max_duration; // longest time in the air of any flight, seconds
+};
+
+namespace
+{
+
+// same as itinerary::add(), from the record alone
+itinerary extend(const itinerary& prev, size_t id, const stream_record& r) {
+    assert(prev.origin == static_cast<airport>(r.from) || prev.flight_ids.size());
+
+    itinerary next = prev;
+    next.flight_ids.push_back(flight_id(id));
+    if(next.flight_ids.size() == 1ul) {
+        next.origin = static_cast<airport>(r.from);
+    }
+    next.legs += r.num_stops + 1u;
+
+    return next;
+}
+
+} // namespace
+
+/**
+ * @brief sort flights by arrival and write them to path in stream format
+ *
+ * @param path file to write
+ * @param f rvalue of flights
+ */
+void write_stream(const std::string& path, std::vector<flight>&& f) {
+    std::stable_sort(f.begin(), f.end(), [](const flight& lhs, const flight& rhs) {
+        return lhs.arrive_ts < rhs.arrive_ts;
+    });
+
+    stream_header header;
+    std::memcpy(header.magic, STREAM_MAGIC, sizeof(STREAM_MAGIC));
+    header.count = f.size();
+    header.max_duration = 0;
+    for(const flight& fl : f) {
+        header.max_duration = std::max<int64_t>(header.max_duration, fl.arrive_ts - fl.depart_ts);
+    }
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    assert_m(out.good(), "can't open " + path);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    for(const flight& fl : f) {
+        const stream_record r = to_record(fl);
+        out.write(reinterpret_cast<const char*>(&r), sizeof(r));
+    }
+    assert_m(out.good(), "failed writing " + path);
+}
+
+// streaming implementation of serial_kernel(), flights are read once in arrival order
+// an airport only keeps the states some later flight can still connect from: nothing takes off more
+// than max_duration before it lands, so older states fold into one running best, or with a max
+// layover are dropped outright
+// throws search_expired once until passes, the states it kept go with it
+// budget is a hard limit, states hold full itineraries and nothing spills to disk, so it fails once they outgrow it
+template <class Shape>
+itinerary stream_kernel(std::ifstream& in, const stream_header& header, const connection_rules& rules, airport mandated, size_t budget, const search_deadline& until) {
+    const bool bounded = rules.bounded();
+
+    // itinerary ending with a flight, and best itinerary at its airport once it landed
+    struct state {
+        time_t arrive_ts;
+        itinerary end;
+        itinerary best;
+    };
+    std::vector<std::deque<state> > live(INVALID_AIRPORT + 1ul);
+    auto bytes = [](const state& s) -> size_t {
+        return sizeof(state) + (s.end.flight_ids.capacity() + s.best.flight_ids.capacity()) * sizeof(flight_id);
+    };
+
+    // best at each airport among states dropped from live, blank to begin with
+    std::vector<itinerary> folded;
+    for(size_t a = 0; a <= INVALID_AIRPORT; ++a) {
+        folded.emplace_back(static_cast<airport>(a));
+    }
+
+    // a quarter of the budget buffers reads, the rest holds live states
+    const size_t chunk = std::max<size_t>(1ul, std::min<size_t>(header.count, budget / 4ul / sizeof(stream_record)));
+    assert_m(budget > chunk * sizeof(stream_record), "memory budget of " + std::to_string(budget) + " bytes can't hold a read buffer and any states");
+    const size_t state_budget = budget - chunk * sizeof(stream_record);
+    std::vector<stream_record> buffer(chunk);
+    size_t live_bytes = 0;
+
+    itinerary best = Shape::has_origin ? itinerary(mandated) : itinerary();
+    for(size_t base = 0; base < header.count; base += chunk) {
+        const size_t n = std::min<size_t>(chunk, header.count - base);
+        in.read(reinterpret_cast<char*>(buffer.data()), n * sizeof(stream_record));
+        assert_m(in.good(), "stream ended after " + std::to_string(base) + " of " + std::to_string(header.count) + " flights");
+
+        for(size_t k = 0; k < n; ++k) {
+            until.check(base + k);
+            const stream_record& r = buffer[k];
+            const airport from = static_cast<airport>(r.from);
+            const airport to = static_cast<airport>(r.to);
+
+            // everything departing from now on takes off after now - max_duration
+            auto evict = [&](airport a) {
+                const time_t horizon = r.arrive_ts - header.max_duration;
+                std::deque<state>& at = live[a];
+                while(at.size() && (bounded ? at.front().arrive_ts < horizon - rules.max_layover[a] : at.front().arrive_ts <= horizon - rules.min_connect[a])) {
+                    live_bytes -= bytes(at.front());
+                    folded[a] = std::move(at.front().best);
+                    at.pop_front();
+                }
+            };
+            evict(from);
+            evict(to);
+
+            const std::deque<state>& src = live[from];
+            const time_t latest = r.depart_ts - rules.min_connect[from];
+            auto comp = [](const state& lhs, const time_t& rhs) -> bool {
+                return lhs.arrive_ts <= rhs;
+            };
+            auto connect = std::lower_bound(src.begin(), src.end(), latest, comp);
+
+            itinerary incoming;
+            if(!bounded) {
+                // same lookup as flight_finder::opt_state()
+                incoming = extend(connect == src.begin() ? folded[from] : (connect - 1)->best, base + k, r);
+            } else {
+                // same choice as flight_finder::bounded_sweep(), the window is short so scan it
+                incoming = extend(itinerary(from), base + k, r);
+                for(auto it = connect; it != src.begin() && r.depart_ts - (it - 1)->arrive_ts <= rules.max_layover[from]; --it) {
+                    incoming = itinerary::better<Shape>(extend((it - 1)->end, base + k, r), incoming, mandated);
+                }
+            }
+
+            std::deque<state>& dest = live[to];
+            const itinerary& prev = dest.empty() ? folded[to] : dest.back().best;
+            itinerary here = itinerary::better<Shape>(incoming, prev, mandated);
+            best = itinerary::better<Shape>(best, here, mandated);
+
+            dest.push_back({r.arrive_ts, std::move(incoming), std::move(here)});
+            live_bytes += bytes(dest.back());
+            assert_m(live_bytes <= state_budget, "memory budget too small for the states still reachable at " + std::to_string(r.arrive_ts));
+        }
+    }
+
+    return best;
+}
+
+/**
+ * @brief best itinerary over the flights in a stream file, reading it once plus once per flight on the result
+ *
+ * @param path file written by write_stream()
+ * @param constrs constraints applied during search, origin and connection rules
+ * @param budget bytes for read buffers and live states, exceeding it fails the search
+ * @param deadline when to give up, with search_expired
+ */
+std::string stream_search(const std::string& path, const flight_constraints& constrs, size_t budget, const search_deadline& deadline = search_deadline()) {
+    std::ifstream in(path, std::ios::binary);
+    assert_m(in.good(), "can't open " + path);
+
+    stream_header header;
+    in.read(reinterpret_cast<char*>(&header), sizeof(header));
+    assert_m(in.good() && std::memcmp(header.magic, STREAM_MAGIC, sizeof(STREAM_MAGIC)) == 0, path + " is not a stream file");
+
+    const itinerary best = constrs.origin.has_value()
+        ? stream_kernel<query_shape<true> >(in, header, constrs.rules, constrs.origin.value(), budget, deadline)
+        : stream_kernel<query_shape<false> >(in, header, constrs.rules, INVALID_AIRPORT, budget, deadline);
+
+    // records are fixed size, seek straight to the ones on the result
+    std::stringstream ss;
+    for(size_t i = 0; i < best.flight_ids.size(); ++i) {
+        const size_t id = best.flight_ids[i].id;
+        in.clear();
+        in.seekg(sizeof(stream_header) + id * sizeof(stream_record));
+
+        stream_record r;
+        in.read(reinterpret_cast<char*>(&r), sizeof(r));
+        assert_m(in.good(), "can't read flight " + std::to_string(id) + " of " + path);
+
+        ss << std::to_string(i + 1ul) << ". " << to_flight(r, id).serialize();
+    }
+
+    return ss.str();
+}
+
+#ifndef REMOVE_MAIN_FUNC
+/**
+ * @brief stream.x options that aren't search constraints
+ */
+struct stream_options
+{
+    std::string file;        // sorted flight file to search, or to write
+    bool write = false;      // sort the parsed flights into file instead
+    size_t budget_mb = 1024; // memory for read buffers and live states, the search fails past it
+};
+
+int main(int argc, char** argv) {
+    cxxopts::Options options = search_options("stream");
+    options.add_options()
+        ("file",   "Sorted flight file", cxxopts::value<std::string>())
+        ("write",  "Write parsed flights to --file", cxxopts::value<bool>()->default_value("false"))
+        ("budget", "Memory budget in MB, fails if exceeded", cxxopts::value<size_t>()->default_value("1024"));
+    const cxxopts::ParseResult result = parse_options(options, argc, argv);
+    flight_constraints constrs = search_constraints(result);
+
+    assert_m(result.count("file") > 0ul, "stream needs --file");
+    stream_options opts;
+    opts.file = result["file"].as<std::string>();
+    opts.write = result["write"].as<bool>();
+    opts.budget_mb = result["budget"].as<size_t>();
+    assert_m(opts.budget_mb >= 1ul, "need a memory budget of at least 1 MB");
+
+    if(opts.write) {
+        std::cout << "writing stream" << std::endl;
+
+        std::string directory = "flight_concurr_arr_results";
+        std::vector<flight> flights = parse_flights_from_directory(directory, constrs);
+        write_stream(opts.file, std::move(flights));
+
+        return 0;
+    }
+
+    std::cout << "running stream" << std::endl;
+
+    const search_deadline deadline = constrs.deadline_ms.has_value() ? search_deadline::after(std::chrono::milliseconds(constrs.deadline_ms.value())) : search_deadline();
+    time_point<high_resolution_clock> start = high_resolution_clock::now();
+    asm volatile ("" ::: "memory");
+    try {
+        std::cout << stream_search(opts.file, constrs, opts.budget_mb << 20, deadline) << std::endl;
+    } catch(const search_expired& e) {
+        std::cout << e.what() << std::endl;
+        return 1;
+    }
+    asm volatile ("" ::: "memory");
+    time_point<high_resolution_clock> end = high_resolution_clock::now();
+
+    auto execution_ms = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+    std::cout << "execution time: " << execution_ms << "ms" << std::endl;
+
+    return 0;
+}
+#endif
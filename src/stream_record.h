@@ -0,0 +1,68 @@
+#ifndef STREAM_RECORD_H
+#define STREAM_RECORD_H
+
+#include "common_data_types.h"
+#include <cstring>
+
+// one flight, fixed size so a record can be found by its position
+// pointer free, so records can be written to a file or mapped into another process as they are
+struct stream_record
+{
+    int64_t depart_ts;
+    int64_t arrive_ts;
+    uint32_t price;
+    uint32_t num_stops;
+    int32_t day;
+    uint8_t al;
+    uint8_t from;
+    uint8_t to;
+    uint8_t fare_class;
+    char depart_time[16];
+    char arrive_time[16];
+    char stops[48];
+};
+
+// copy a string into a fixed size field, with room for the terminator
+template <size_t N>
+void pack(char (&field)[N], const std::string& str) {
+    assert_m(str.size() < N, "\"" + str + "\" doesn't fit a stream record");
+    std::memset(field, 0, N);
+    std::memcpy(field, str.data(), str.size());
+}
+
+inline stream_record to_record(const flight& f) {
+    stream_record r;
+    r.depart_ts = f.depart_ts;
+    r.arrive_ts = f.arrive_ts;
+    r.price = f.price;
+    r.num_stops = f.num_stops;
+    r.day = f.day;
+    r.al = static_cast<uint8_t>(f.al);
+    r.from = static_cast<uint8_t>(f.from);
+    r.to = static_cast<uint8_t>(f.to);
+    r.fare_class = static_cast<uint8_t>(f.fare_class);
+    pack(r.depart_time, f.depart_time);
+    pack(r.arrive_time, f.arrive_time);
+    pack(r.stops, f.stops);
+    return r;
+}
+
+inline flight to_flight(const stream_record& r, size_t id) {
+    flight f;
+    f.id = id;
+    f.al = static_cast<airline>(r.al);
+    f.from = static_cast<airport>(r.from);
+    f.to = static_cast<airport>(r.to);
+    f.depart_ts = r.depart_ts;
+    f.arrive_ts = r.arrive_ts;
+    f.depart_time = r.depart_time;
+    f.arrive_time = r.arrive_time;
+    f.stops = r.stops;
+    f.num_stops = r.num_stops;
+    f.day = r.day;
+    f.fare_class = static_cast<cabin>(r.fare_class);
+    f.price = r.price;
+    return f;
+}
+
+#endif // STREAM_RECORD_H
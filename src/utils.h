@@ -40,6 +40,16 @@ struct assertion_failure_exception : public std::exception {
     }                                                                                                        \
 } while(0)
 
+// 64 bit FNV-1a, continuing from h
+constexpr uint64_t FNV_OFFSET = 14695981039346656037ul;
+inline uint64_t fnv1a(uint64_t h, const void* data, size_t n) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for(size_t i = 0; i < n; ++i) {
+        h = (h ^ bytes[i]) * 1099511628211ul;
+    }
+    return h;
+}
+
 /**
  * @brief helpers to check if struct has 'id' field of a certain type
 */
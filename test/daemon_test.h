@@ -0,0 +1,132 @@
+#define REMOVE_MAIN_FUNC
+#include "../src/daemon.cpp"
+#undef REMOVE_MAIN_FUNC
+
+#include "catch/catch.hpp"
+
+#include <thread>
+
+// a loader handing out flights from memory, a different set on each reload
+static resident_index::loader memory_loader(std::vector<std::shared_ptr<const std::vector<flight> > > generations) {
+    auto next = std::make_shared<std::atomic<size_t> >(0ul);
+    return [generations, next]() {
+        flight_source source;
+        source.parsed = generations[std::min(next->fetch_add(1ul), generations.size() - 1ul)];
+        return source;
+    };
+}
+
+TEST_CASE("daemon answers query lines d=5", "[daemon],[top5],[quick],[d]") {
+    const auto all = std::make_shared<const std::vector<flight> >(parse_flights_from_directory(data_dir_top5, flight_constraints()));
+    resident_index index(memory_loader({all}));
+    query_scheduler scheduler(1ul, 64ul);
+
+    const std::string line = "-d 5 -o DEN -u 1734900000 --since 1734880000";
+    const flight_constraints constrs = cli_line("serial", line);
+    flight_finder ff(filter_flights(*all, constrs), constrs);
+
+    const json reply = answer(index, scheduler, line);
+    REQUIRE(reply["ok"] == true);
+    REQUIRE(reply["flights"] == ff.stats().total);
+    REQUIRE(reply["generation"] == 0ul);
+    REQUIRE(reply["result"] == legs(ff.search<OptLevel::SERIAL>()));
+    REQUIRE(reply["until"].size() == 1ul);
+    REQUIRE(reply["until"][0]["end_ts"] == 1734900000);
+    REQUIRE(reply["until"][0]["result"] == legs(ff.search_ending_by<OptLevel::SERIAL>(1734900000)));
+    REQUIRE(reply["since"].size() == 1ul);
+    REQUIRE(reply["since"][0]["start_ts"] == 1734880000);
+    REQUIRE(reply["since"][0]["result"] == legs(ff.search_starting_from(1734880000)));
+    REQUIRE(reply.contains("search_us"));
+
+    // errors come back as replies, the connection carries on
+    const json bad = answer(index, scheduler, "-o NOWHERE");
+    REQUIRE(bad["ok"] == false);
+    REQUIRE(bad["error"].is_string());
+    REQUIRE(answer(index, scheduler, "-d 5 -o DEN --deadline_ms 0") == json({{"ok", false}, {"error", "deadline"}}));
+
+    // no workers and no room in the queue turns everything away
+    query_scheduler full(0ul, 0ul);
+    REQUIRE(answer(index, full, line) == json({{"ok", false}, {"error", "overloaded"}}));
+}
+
+TEST_CASE("daemon reload swaps in new flights behind running queries d=5", "[daemon],[top5],[quick],[d]") {
+    const auto all = std::make_shared<const std::vector<flight> >(parse_flights_from_directory(data_dir_top5, flight_constraints()));
+    const auto fewer = std::make_shared<const std::vector<flight> >(all->begin(), all->begin() + all->size() / 2ul);
+    resident_index index(memory_loader({all, fewer}));
+
+    const flight_constraints constrs = cli_line("serial", "-d 5 -o DEN");
+    const std::shared_ptr<index_entry> before = index.entry(constrs);
+    REQUIRE(before->generation == 0ul);
+    REQUIRE(index.entry(constrs) == before);
+    const std::string old_result = before->finder->search<OptLevel::SERIAL>();
+
+    REQUIRE(index.reload());
+    while(index.busy()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    REQUIRE(index.generation() == 1ul);
+    REQUIRE(index.size() == fewer->size());
+
+    // whoever still holds the old entry finishes on the old flights
+    REQUIRE(before->finder->search<OptLevel::SERIAL>() == old_result);
+
+    // the new one was built before the swap, from the new flights
+    const std::shared_ptr<index_entry> after = index.entry(constrs);
+    REQUIRE(after != before);
+    REQUIRE(after->generation == 1ul);
+    REQUIRE(after->finder->search<OptLevel::SERIAL>() == flight_finder(filter_flights(*fewer, constrs), constrs).search<OptLevel::SERIAL>());
+}
+
+TEST_CASE("daemon drops clients sending overlong lines d=5", "[daemon],[top5],[quick],[d]") {
+    const auto all = std::make_shared<const std::vector<flight> >(parse_flights_from_directory(data_dir_top5, flight_constraints()));
+    resident_index index(memory_loader({all}));
+    query_scheduler scheduler(1ul, 64ul);
+
+    int fds[2];
+    REQUIRE(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+    std::thread server([&]() {
+        serve(index, scheduler, fds[1]);
+        close(fds[1]);
+    });
+
+    auto read_all = [](int fd) {
+        std::string out;
+        char buf[4096];
+        for(ssize_t n; (n = recv(fd, buf, sizeof(buf), 0)) > 0;) {
+            out.append(buf, n);
+        }
+        return out;
+    };
+
+    // a query line is answered, then a line without an end past MAX_LINE closes the connection
+    REQUIRE(send_all(fds[0], "-d 5 -o DEN\n" + std::string(MAX_LINE + 1ul, 'x')));
+    const std::string replies = read_all(fds[0]);
+    server.join();
+    close(fds[0]);
+
+    std::stringstream ss(replies);
+    std::string first, second;
+    REQUIRE(std::getline(ss, first));
+    REQUIRE(std::getline(ss, second));
+    REQUIRE(json::parse(first)["ok"] == true);
+    REQUIRE(json::parse(second) == json({{"ok", false}, {"error", "line too long"}}));
+}
+
+TEST_CASE("daemon index outlives the reload it started d=5", "[daemon],[top5],[quick],[d]") {
+    const auto all = std::make_shared<const std::vector<flight> >(parse_flights_from_directory(data_dir_top5, flight_constraints()));
+    std::atomic<size_t> loads = 0;
+    {
+        // the second load is still running when the index goes away, which waits for it
+        resident_index index([&all, &loads]() {
+            if(loads++ > 0ul) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            }
+            flight_source source;
+            source.parsed = all;
+            return source;
+        });
+        REQUIRE(index.reload());
+        REQUIRE_FALSE(index.reload());
+    }
+    REQUIRE(loads == 2ul);
+}
@@ -0,0 +1,35 @@
+#include "../src/shared_dataset.h"
+
+#include "catch/catch.hpp"
+
+TEST_CASE("shared dataset maps the flights parsing would give", "[dataset],[top5],[quick],[d]") {
+    const std::string path = (std::filesystem::temp_directory_path() / "flight_finder_dataset_test").string();
+
+    uint64_t fingerprint = 0;
+    const std::vector<flight> all = parse_flights_from_directory(data_dir_top5, flight_constraints(), false, &fingerprint);
+    shared_dataset::publish(path, all);
+
+    // two mappings, as two workers would have
+    const shared_dataset first(path);
+    const shared_dataset second(path);
+    REQUIRE(first.size() == all.size());
+    REQUIRE(first.fingerprint() == fingerprint);
+    REQUIRE(first.at(all.size() - 1ul).serialize() == all.back().serialize());
+
+    for(const char* line : {"-d 5", "-d 3 -c Economy -o DEN", "-a American -e 1734900000"}) {
+        const flight_constraints constrs = cli_line("serial", line);
+        const std::vector<flight> expected = filter_flights(all, constrs);
+        const std::vector<flight> selected = second.select(constrs);
+
+        REQUIRE(flights_fingerprint(selected) == flights_fingerprint(expected));
+        REQUIRE(flight_finder(std::vector<flight>(selected), constrs).search<OptLevel::SERIAL>() == flight_finder(std::vector<flight>(expected), constrs).search<OptLevel::SERIAL>());
+    }
+
+    // publishing again replaces the file, the old mapping still reads what it mapped
+    shared_dataset::publish(path, std::vector<flight>(all.begin(), all.begin() + 10));
+    REQUIRE(shared_dataset(path).size() == 10ul);
+    REQUIRE(first.size() == all.size());
+    REQUIRE(first.at(all.size() - 1ul).serialize() == all.back().serialize());
+
+    std::filesystem::remove(path);
+}
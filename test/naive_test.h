@@ -17,9 +17,9 @@ TEST_CASE("naive top5 depart=ATL d=150 cabin=Economy", "[naive],[top5],[quick],[
     const std::string result = ff.search<OptLevel::NAIVE>();
 
     const std::string expected{
-       "1. Southwest flight from ATL @ 8:05 AM to DEN @ 1:00 PM (1 stop in MDW) in Economy for $234\
-        2. Delta flight from DEN @ 2:18 PM to DFW @ 10:00 PM (1 stop in ATL) in Economy for $509\
-        3. American flight from DFW @ 10:30 PM to DEN @ 3:15 PM+1 (1 stop in PHX) in Economy for $362"
+        "1. Southwest flight from ATL @ 8:05 AM to DEN @ 11:45 AM (1 stop in MCI) in Economy for $234\
+        2. American flight from DEN @ 6:46 PM to LAX @ 10:03 PM (1 stop in PHX) in Economy for $164\
+        3. American flight from LAX @ 11:55 PM to DFW @ 5:01 AM+1 (Nonstop) in Economy for $314"
     };
 
     REQUIRE(remove_whitespace(result) == remove_whitespace(expected));
@@ -38,8 +38,8 @@ TEST_CASE("naive top5 depart=DEN d=150 cabin=Economy", "[naive],[top5],[quick],[
     const std::string result = ff.search<OptLevel::NAIVE>();
 
     const std::string expected{
-        "1. Delta flight from DEN @ 2:18 PM to DFW @ 10:00 PM (1 stop in ATL) in Economy for $509\
-        2. American flight from DFW @ 10:30 PM to DEN @ 3:15 PM+1 (1 stop in PHX) in Economy for $362"
+        "1. Delta flight from DEN @ 7:00 AM to ORD @ 4:12 PM (1 stop in ATL) in Economy for $579\
+        2. American flight from ORD @ 8:45 PM to LAX @ 8:17 AM+1 (1 stop in LAS) in Economy for $302"
     };
 
     REQUIRE(remove_whitespace(result) == remove_whitespace(expected));
@@ -58,9 +58,9 @@ TEST_CASE("naive top5 depart=DFW d=150 cabin=Economy", "[naive],[top5],[quick],[
     const std::string result = ff.search<OptLevel::NAIVE>();
 
     const std::string expected{
-        "1. American flight from DFW @ 10:25 AM to DEN @ 11:46 AM (Nonstop) in Economy for $299\
-        2. Delta flight from DEN @ 2:18 PM to DFW @ 10:00 PM (1 stop in ATL) in Economy for $509\
-        3. American flight from DFW @ 10:30 PM to DEN @ 3:15 PM+1 (1 stop in PHX) in Economy for $362"
+        "1. United flight from DFW @ 8:00 AM to DEN @ 11:42 AM (1 stop in IAH) in Economy for $268\
+        2. American flight from DEN @ 6:46 PM to LAX @ 10:03 PM (1 stop in PHX) in Economy for $164\
+        3. American flight from LAX @ 11:55 PM to DFW @ 5:01 AM+1 (Nonstop) in Economy for $314"
     };
 
     REQUIRE(remove_whitespace(result) == remove_whitespace(expected));
@@ -79,7 +79,10 @@ TEST_CASE("naive top5 depart=LAX d=150 cabin=Economy", "[naive],[top5],[quick],[
     const std::string result = ff.search<OptLevel::NAIVE>();
 
     const std::string expected{
-        "1. JetBlue flight from LAX @ 8:45 PM to ORD @ 9:26 AM+1 (1 stop in JFK) in Economy for $659"
+        "1. Delta flight from LAX @ 8:05 AM to DFW @ 12:56 PM (1 stop in ATL) in Economy for $908\
+        2. American flight from DFW @ 4:44 PM to DEN @ 5:51 PM (Nonstop) in Economy for $239\
+        3. American flight from DEN @ 6:46 PM to LAX @ 10:03 PM (1 stop in PHX) in Economy for $164\
+        4. American flight from LAX @ 11:55 PM to DFW @ 5:01 AM+1 (Nonstop) in Economy for $314"
     };
 
     REQUIRE(remove_whitespace(result) == remove_whitespace(expected));
@@ -98,8 +101,7 @@ TEST_CASE("naive top5 depart=ORD d=150 cabin=Economy", "[naive],[top5],[quick],[
     const std::string result = ff.search<OptLevel::NAIVE>();
 
     const std::string expected{
-        "1. American flight from ORD @ 11:56 AM to DEN @ 5:51 PM (1 stop in DFW) in Economy for $429\
-        2. American flight from DEN @ 6:46 PM to LAX @ 10:03 PM (1 stop in PHX) in Economy for $164"
+        "1. American flight from ORD @ 8:45 PM to LAX @ 8:17 AM+1 (1 stop in LAS) in Economy for $302"
     };
 
     REQUIRE(remove_whitespace(result) == remove_whitespace(expected));
@@ -118,9 +120,10 @@ TEST_CASE("naive top5 d=150 cabin=Economy", "[naive],[top5],[quick],[d],[cabin]"
     const std::string result = ff.search<OptLevel::NAIVE>();
 
     const std::string expected{
-       "1. Southwest flight from ATL @ 8:05 AM to DEN @ 1:00 PM (1 stop in MDW) in Economy for $234\
-        2. Delta flight from DEN @ 2:18 PM to DFW @ 10:00 PM (1 stop in ATL) in Economy for $509\
-        3. American flight from DFW @ 10:30 PM to DEN @ 3:15 PM+1 (1 stop in PHX) in Economy for $362"
+        "1. Delta flight from LAX @ 8:05 AM to DFW @ 12:56 PM (1 stop in ATL) in Economy for $908\
+        2. American flight from DFW @ 4:44 PM to DEN @ 5:51 PM (Nonstop) in Economy for $239\
+        3. American flight from DEN @ 6:46 PM to LAX @ 10:03 PM (1 stop in PHX) in Economy for $164\
+        4. American flight from LAX @ 11:55 PM to DFW @ 5:01 AM+1 (Nonstop) in Economy for $314"
     };
 
     REQUIRE(remove_whitespace(result) == remove_whitespace(expected));
@@ -139,11 +142,11 @@ TEST_CASE("naive top5 d=3", "[naive],[top5],[d]") {
     const std::string result = ff.search<OptLevel::NAIVE>();
 
     const std::string expected{
-        "1. American flight from ATL @ 5:10 AM to DFW @ 9:11 AM (1 stop in CLT) in Economy for $289\
-        2. American flight from DFW @ 9:15 AM to LAX @ 10:41 AM (Nonstop) in Business for $766\
-        3. Delta flight from LAX @ 11:05 AM to DFW @ 5:43 PM (2 stops in CVG, ATL) in Economy for $2071\
-        4. American flight from DFW @ 5:55 PM to LAX @ 8:47 PM (1 stop in LAS) in First for $775\
-        5. United flight from LAX @ 9:40 PM to DEN @ 12:42 PM+1 (2 stops in PIT, ORD) in Economy for $495"
+        "1. American flight from ATL @ 5:10 AM to DFW @ 11:38 AM (2 stops in CLT, STL) in First for $718\
+        2. American flight from DFW @ 12:19 PM to LAX @ 3:22 PM (1 stop in PHX) in Business for $884\
+        3. United flight from LAX @ 3:29 PM to DEN @ 5:56 PM (Nonstop) in Economy for $559\
+        4. American flight from DEN @ 6:46 PM to LAX @ 10:03 PM (1 stop in PHX) in Business for $274\
+        5. Spirit flight from LAX @ 10:39 PM to ATL @ 8:38 PM+1 (2 stops in DTW, FLL) in Economy for $260"
     };
 
     REQUIRE(remove_whitespace(result) == remove_whitespace(expected));
@@ -162,11 +165,11 @@ TEST_CASE("naive top5 d=2", "[naive],[top5],[d]") {
     const std::string result = ff.search<OptLevel::NAIVE>();
 
     const std::string expected{
-        "1.American flight from ATL @5:10 AM to DFW @11:38AM (2 stops in CLTSTL) in Economy for $468\
+        "1. American flight from ATL @ 5:10 AM to DFW @ 11:38 AM (2 stops in CLT, STL) in Business for $718\
         2. American flight from DFW @ 12:19 PM to LAX @ 3:22 PM (1 stop in PHX) in Economy for $323\
-        3. United flight from LAX @ 4:00 PM to DFW @ 10:44 PM (2 stops in DCA, ORD) in Business for $977\
-        4. American flight from DFW @ 10:49 PM to DEN @ 11:58 PM (Nonstop) in First for $259\
-        5. American flight from DEN @ 11:59 PM to ATL @ 9:42 PM+1 (1 stop in CLT) in Business for $862"
+        3. United flight from LAX @ 3:29 PM to DEN @ 5:56 PM (Nonstop) in Economy for $559\
+        4. American flight from DEN @ 6:46 PM to LAX @ 10:03 PM (1 stop in PHX) in First for $274\
+        5. Spirit flight from LAX @ 10:39 PM to ATL @ 8:38 PM+1 (2 stops in DTW, FLL) in Economy for $260"
     };
 
     REQUIRE(remove_whitespace(result) == remove_whitespace(expected));
@@ -204,3 +207,94 @@ TEST_CASE("naive final d=1", "[naive],[final]") {
     REQUIRE(remove_whitespace(result) == remove_whitespace(expected));
 }
 
+
+TEST_CASE("naive top5 memoize d=25 cabin=Economy", "[naive],[top5],[quick],[d],[cabin],[memo]") {
+    flight_constraints constrs = {
+        .airlines = std::nullopt,
+        .fare_class = std::make_optional(cabin::ECONOMY),
+        .origin = std::nullopt,
+        .start_ts = std::nullopt,
+        .div_n = 25
+    };
+    std::vector<flight> flights = parse_flights_from_directory(data_dir_top5, constrs);
+    flight_finder ff(std::move(flights), constrs);
+    const std::string expected = ff.search<OptLevel::NAIVE>();
+
+    constrs.memoize = true;
+    std::vector<flight> memo_flights = parse_flights_from_directory(data_dir_top5, constrs);
+    flight_finder memo_ff(std::move(memo_flights), constrs);
+    const std::string result = memo_ff.search<OptLevel::NAIVE>();
+
+    REQUIRE(!expected.empty());
+    REQUIRE(result == expected);
+}
+
+TEST_CASE("naive top5 memoize depart=DEN d=25 cabin=Economy", "[naive],[top5],[quick],[origin],[d],[cabin],[memo]") {
+    flight_constraints constrs = {
+        .airlines = std::nullopt,
+        .fare_class = std::make_optional(cabin::ECONOMY),
+        .origin = std::make_optional(airport::DEN),
+        .start_ts = std::nullopt,
+        .div_n = 25
+    };
+    std::vector<flight> flights = parse_flights_from_directory(data_dir_top5, constrs);
+    flight_finder ff(std::move(flights), constrs);
+    const std::string expected = ff.search<OptLevel::NAIVE>();
+
+    constrs.memoize = true;
+    std::vector<flight> memo_flights = parse_flights_from_directory(data_dir_top5, constrs);
+    flight_finder memo_ff(std::move(memo_flights), constrs);
+    const std::string result = memo_ff.search<OptLevel::NAIVE>();
+
+    REQUIRE(!expected.empty());
+    REQUIRE(result == expected);
+}
+
+TEST_CASE("naive top5 without departure dates d=25 cabin=Economy", "[naive],[top5],[quick],[d],[cabin]") {
+    flight_constraints constrs = {
+        .airlines = std::nullopt,
+        .fare_class = std::make_optional(cabin::ECONOMY),
+        .origin = std::nullopt,
+        .start_ts = std::nullopt,
+        .div_n = 25
+    };
+    std::vector<flight> flights = parse_flights_from_directory(data_dir_top5, constrs);
+    flight_finder ff(std::vector<flight>(flights), constrs);
+
+    // every top5 flight was searched for 2024-12-22, the boundary flights without a date fall back to
+    for(flight& f : flights) {
+        f.day = NO_DAY;
+    }
+    flight_finder undated(std::move(flights), constrs);
+
+    REQUIRE(undated.search<OptLevel::NAIVE>() == ff.search<OptLevel::NAIVE>());
+}
+
+TEST_CASE("naive top5 past its deadline returns its best so far d=25 cabin=Economy", "[naive],[top5],[quick],[d],[cabin],[deadline]") {
+    flight_constraints constrs = {
+        .airlines = std::nullopt,
+        .fare_class = std::make_optional(cabin::ECONOMY),
+        .origin = std::nullopt,
+        .start_ts = std::nullopt,
+        .div_n = 25
+    };
+    std::vector<flight> flights = parse_flights_from_directory(data_dir_top5, constrs);
+
+    for(bool memoize : {false, true}) {
+        constrs.memoize = memoize;
+        flight_finder ff(std::vector<flight>(flights), constrs);
+        const std::string expected = ff.search<OptLevel::NAIVE>();
+        REQUIRE(!ff.partial());
+
+        // cancelled before it starts, so nothing is explored and the best is still blank
+        std::shared_ptr<std::atomic<bool> > cancel = std::make_shared<std::atomic<bool> >(true);
+        ff.set_deadline({std::nullopt, cancel});
+        REQUIRE(ff.search<OptLevel::NAIVE>().empty());
+        REQUIRE(ff.partial());
+
+        // whoever holds the token can take it back
+        *cancel = false;
+        REQUIRE(ff.search<OptLevel::NAIVE>() == expected);
+        REQUIRE(!ff.partial());
+    }
+}
@@ -0,0 +1,121 @@
+#include "../src/scheduler.h"
+
+#include "catch/catch.hpp"
+
+TEST_CASE("scheduler coalesces and turns away queries d=25", "[scheduler],[top5],[quick],[d]") {
+    flight_constraints constrs = {
+        .airlines = std::nullopt,
+        .fare_class = std::nullopt,
+        .origin = std::nullopt,
+        .start_ts = std::nullopt,
+        .div_n = 25
+    };
+    std::shared_ptr<const flight_finder> ff = std::make_shared<flight_finder>(parse_flights_from_directory(data_dir_top5, constrs), constrs);
+
+    // no workers, so everything submitted stays queued
+    query_scheduler scheduler(0ul, 2ul);
+    const search_query q = {.origin = std::make_optional(airport::DEN)};
+    auto first = scheduler.submit(ff, "top5", q);
+    auto again = scheduler.submit(ff, "top5", q);
+    auto other = scheduler.submit(ff, "top5", {.origin = std::make_optional(airport::DEN), .end_ts = 1734900000});
+    auto full = scheduler.submit(ff, "top5", {.origin = std::make_optional(airport::ATL)});
+
+    REQUIRE(first.has_value());
+    REQUIRE(again.has_value());
+    REQUIRE(other.has_value());
+    REQUIRE(!full.has_value());
+
+    const scheduler_stats stats = scheduler.stats();
+    REQUIRE(stats.submitted == 4ul);
+    REQUIRE(stats.coalesced == 1ul);
+    REQUIRE(stats.rejected == 1ul);
+}
+
+TEST_CASE("scheduler top5 results match const search d=5", "[scheduler],[top5],[quick],[d]") {
+    flight_constraints constrs = {
+        .airlines = std::nullopt,
+        .fare_class = std::nullopt,
+        .origin = std::nullopt,
+        .start_ts = std::nullopt,
+        .div_n = 5
+    };
+    std::shared_ptr<const flight_finder> ff = std::make_shared<flight_finder>(parse_flights_from_directory(data_dir_top5, constrs), constrs);
+
+    std::vector<search_query> queries;
+    for(std::optional<airport> o : {std::optional<airport>(), std::make_optional(airport::DEN), std::make_optional(airport::LAX)}) {
+        for(time_t end_ts : {1734850000l, 1734900000l, 1734950000l}) {
+            queries.push_back({.origin = o, .end_ts = end_ts});
+        }
+    }
+
+    query_scheduler scheduler(3ul, 64ul);
+    std::vector<std::shared_future<std::string> > results;
+    for(size_t round = 0; round < 3ul; ++round) {
+        for(const search_query& q : queries) {
+            auto result = scheduler.submit(ff, "top5", q);
+            REQUIRE(result.has_value());
+            results.push_back(result.value());
+        }
+    }
+
+    search_workspace ws;
+    for(size_t i = 0; i < results.size(); ++i) {
+        REQUIRE(results[i].get() == ff->search(queries[i % queries.size()], ws));
+    }
+}
+
+TEST_CASE("scheduler fails queries past their deadline d=5", "[scheduler],[top5],[quick],[d],[deadline]") {
+    flight_constraints constrs = {
+        .airlines = std::nullopt,
+        .fare_class = std::nullopt,
+        .origin = std::nullopt,
+        .start_ts = std::nullopt,
+        .div_n = 5
+    };
+    std::shared_ptr<const flight_finder> ff = std::make_shared<flight_finder>(parse_flights_from_directory(data_dir_top5, constrs), constrs);
+    const search_query q = {.origin = std::make_optional(airport::DEN)};
+    search_workspace ws;
+    const std::string expected = ff->search(q, ws);
+
+    // a query without a deadline doesn't share the computation of one about to give up
+    query_scheduler scheduler(1ul, 64ul);
+    auto late = scheduler.submit(ff, "top5", q, search_deadline::after(std::chrono::milliseconds(0)));
+    auto patient = scheduler.submit(ff, "top5", q);
+    REQUIRE(late.has_value());
+    REQUIRE(patient.has_value());
+
+    REQUIRE_THROWS_AS(late.value().get(), search_expired);
+    REQUIRE(patient.value().get() == expected);
+
+    const scheduler_stats stats = scheduler.stats();
+    REQUIRE(stats.coalesced == 0ul);
+    REQUIRE(stats.expired == 1ul);
+}
+
+TEST_CASE("scheduler fails batched queries past their own deadline d=5", "[scheduler],[top5],[quick],[d],[deadline]") {
+    flight_constraints constrs = {
+        .airlines = std::nullopt,
+        .fare_class = std::nullopt,
+        .origin = std::nullopt,
+        .start_ts = std::nullopt,
+        .div_n = 5
+    };
+    std::shared_ptr<const flight_finder> ff = std::make_shared<flight_finder>(parse_flights_from_directory(data_dir_top5, constrs), constrs);
+    const search_query patient_q = {.origin = std::make_optional(airport::DEN)};
+    const search_query tight_q = {.origin = std::make_optional(airport::DEN), .end_ts = 1734900000};
+    search_workspace ws;
+    const std::string expected = ff->search(patient_q, ws);
+
+    // whether the tight one is dropped before the shared sweep or after it, only it fails
+    std::shared_ptr<std::atomic<bool> > cancel = std::make_shared<std::atomic<bool> >(false);
+    query_scheduler scheduler(1ul, 64ul);
+    auto patient = scheduler.submit(ff, "top5", patient_q);
+    auto tight = scheduler.submit(ff, "top5", tight_q, {std::nullopt, cancel});
+    cancel->store(true);
+    REQUIRE(patient.has_value());
+    REQUIRE(tight.has_value());
+
+    REQUIRE(patient.value().get() == expected);
+    REQUIRE_THROWS_AS(tight.value().get(), search_expired);
+    REQUIRE(scheduler.stats().expired == 1ul);
+}
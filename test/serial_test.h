@@ -4,6 +4,8 @@
 
 #include "catch/catch.hpp"
 
+#include <thread>
+
 TEST_CASE("serial top5 depart=ATL d=150 cabin=Economy", "[serial],[top5],[quick],[origin],[d],[cabin]") {
     flight_constraints constrs = {
         .airlines = std::nullopt,
@@ -17,9 +19,9 @@ TEST_CASE("serial top5 depart=ATL d=150 cabin=Economy", "[serial],[top5],[quick]
     const std::string result = ff.search<OptLevel::SERIAL>();
 
     const std::string expected{
-        "1. Southwest flight from ATL @ 8:05 AM to DEN @ 1:00 PM (1 stop in MDW) in Economy for $234\
-        2. Delta flight from DEN @ 2:18 PM to DFW @ 10:00 PM (1 stop in ATL) in Economy for $509\
-        3. American flight from DFW @ 10:30 PM to DEN @ 3:15 PM+1 (1 stop in PHX) in Economy for $362"
+        "1. Southwest flight from ATL @ 8:05 AM to DEN @ 11:45 AM (1 stop in MCI) in Economy for $234\
+        2. American flight from DEN @ 6:46 PM to LAX @ 10:03 PM (1 stop in PHX) in Economy for $164\
+        3. American flight from LAX @ 11:55 PM to DFW @ 5:01 AM+1 (Nonstop) in Economy for $314"
     };
 
     REQUIRE(remove_whitespace(result) == remove_whitespace(expected));
@@ -38,8 +40,8 @@ TEST_CASE("serial top5 depart=DEN d=150 cabin=Economy", "[serial],[top5],[quick]
     const std::string result = ff.search<OptLevel::SERIAL>();
 
     const std::string expected{
-        "1. Delta flight from DEN @ 2:18 PM to DFW @ 10:00 PM (1 stop in ATL) in Economy for $509\
-        2. American flight from DFW @ 10:30 PM to DEN @ 3:15 PM+1 (1 stop in PHX) in Economy for $362"
+        "1. Delta flight from DEN @ 7:00 AM to ORD @ 4:12 PM (1 stop in ATL) in Economy for $579\
+        2. American flight from ORD @ 8:45 PM to LAX @ 8:17 AM+1 (1 stop in LAS) in Economy for $302"
     };
 
     REQUIRE(remove_whitespace(result) == remove_whitespace(expected));
@@ -58,9 +60,9 @@ TEST_CASE("serial top5 depart=DFW d=150 cabin=Economy", "[serial],[top5],[quick]
     const std::string result = ff.search<OptLevel::SERIAL>();
 
     const std::string expected{
-        "1. American flight from DFW @ 10:25 AM to DEN @ 11:46 AM (Nonstop) in Economy for $299\
-        2. Delta flight from DEN @ 2:18 PM to DFW @ 10:00 PM (1 stop in ATL) in Economy for $509\
-        3. American flight from DFW @ 10:30 PM to DEN @ 3:15 PM+1 (1 stop in PHX) in Economy for $362"
+        "1. United flight from DFW @ 8:00 AM to DEN @ 11:42 AM (1 stop in IAH) in Economy for $268\
+        2. American flight from DEN @ 6:46 PM to LAX @ 10:03 PM (1 stop in PHX) in Economy for $164\
+        3. American flight from LAX @ 11:55 PM to DFW @ 5:01 AM+1 (Nonstop) in Economy for $314"
     };
 
     REQUIRE(remove_whitespace(result) == remove_whitespace(expected));
@@ -79,7 +81,10 @@ TEST_CASE("serial top5 depart=LAX d=150 cabin=Economy", "[serial],[top5],[quick]
     const std::string result = ff.search<OptLevel::SERIAL>();
 
     const std::string expected{
-        "1. JetBlue flight from LAX @ 8:45 PM to ORD @ 9:26 AM+1 (1 stop in JFK) in Economy for $659"
+        "1. Delta flight from LAX @ 8:05 AM to DFW @ 12:56 PM (1 stop in ATL) in Economy for $908\
+        2. American flight from DFW @ 4:44 PM to DEN @ 5:51 PM (Nonstop) in Economy for $239\
+        3. American flight from DEN @ 6:46 PM to LAX @ 10:03 PM (1 stop in PHX) in Economy for $164\
+        4. American flight from LAX @ 11:55 PM to DFW @ 5:01 AM+1 (Nonstop) in Economy for $314"
     };
 
     REQUIRE(remove_whitespace(result) == remove_whitespace(expected));
@@ -98,8 +103,7 @@ TEST_CASE("serial top5 depart=ORD d=150 cabin=Economy", "[serial],[top5],[quick]
     const std::string result = ff.search<OptLevel::SERIAL>();
 
     const std::string expected{
-        "1. American flight from ORD @ 11:56 AM to DEN @ 5:51 PM (1 stop in DFW) in Economy for $429\
-        2. American flight from DEN @ 6:46 PM to LAX @ 10:03 PM (1 stop in PHX) in Economy for $164"
+        "1. American flight from ORD @ 8:45 PM to LAX @ 8:17 AM+1 (1 stop in LAS) in Economy for $302"
     };
 
     REQUIRE(remove_whitespace(result) == remove_whitespace(expected));
@@ -118,9 +122,10 @@ TEST_CASE("serial top5 d=150 cabin=Economy", "[serial],[top5],[quick],[d],[cabin
     const std::string result = ff.search<OptLevel::SERIAL>();
 
     const std::string expected{
-        "1. Southwest flight from ATL @ 8:05 AM to DEN @ 1:00 PM (1 stop in MDW) in Economy for $234\
-        2. Delta flight from DEN @ 2:18 PM to DFW @ 10:00 PM (1 stop in ATL) in Economy for $509\
-        3. American flight from DFW @ 10:30 PM to DEN @ 3:15 PM+1 (1 stop in PHX) in Economy for $362"
+        "1. Delta flight from LAX @ 8:05 AM to DFW @ 12:56 PM (1 stop in ATL) in Economy for $908\
+        2. American flight from DFW @ 4:44 PM to DEN @ 5:51 PM (Nonstop) in Economy for $239\
+        3. American flight from DEN @ 6:46 PM to LAX @ 10:03 PM (1 stop in PHX) in Economy for $164\
+        4. American flight from LAX @ 11:55 PM to DFW @ 5:01 AM+1 (Nonstop) in Economy for $314"
     };
 
     REQUIRE(remove_whitespace(result) == remove_whitespace(expected));
@@ -139,11 +144,11 @@ TEST_CASE("serial top5 d=3", "[serial],[top5],[quick],[d]") {
     const std::string result = ff.search<OptLevel::SERIAL>();
 
     const std::string expected{
-        "1. American flight from ATL @ 5:10 AM to DFW @ 9:11 AM (1 stop in CLT) in Economy for $289\
-        2. American flight from DFW @ 9:15 AM to LAX @ 10:41 AM (Nonstop) in Business for $766\
-        3. Delta flight from LAX @ 11:05 AM to DFW @ 5:43 PM (2 stops in CVG, ATL) in Economy for $2071\
-        4. American flight from DFW @ 5:55 PM to LAX @ 8:47 PM (1 stop in LAS) in First for $775\
-        5. United flight from LAX @ 9:40 PM to DEN @ 12:42 PM+1 (2 stops in PIT, ORD) in Economy for $495"
+        "1. American flight from ATL @ 5:10 AM to DFW @ 11:38 AM (2 stops in CLT, STL) in First for $718\
+        2. American flight from DFW @ 12:19 PM to LAX @ 3:22 PM (1 stop in PHX) in Business for $884\
+        3. United flight from LAX @ 3:29 PM to DEN @ 5:56 PM (Nonstop) in Economy for $559\
+        4. American flight from DEN @ 6:46 PM to LAX @ 10:03 PM (1 stop in PHX) in Business for $274\
+        5. Spirit flight from LAX @ 10:39 PM to ATL @ 8:38 PM+1 (2 stops in DTW, FLL) in Economy for $260"
     };
 
     REQUIRE(remove_whitespace(result) == remove_whitespace(expected));
@@ -162,11 +167,11 @@ TEST_CASE("serial top5 d=2", "[serial],[top5],[quick],[d]") {
     const std::string result = ff.search<OptLevel::SERIAL>();
 
     const std::string expected{
-        "1.American flight from ATL @5:10 AM to DFW @11:38AM (2 stops in CLTSTL) in Economy for $468\
+        "1. American flight from ATL @ 5:10 AM to DFW @ 11:38 AM (2 stops in CLT, STL) in Business for $718\
         2. American flight from DFW @ 12:19 PM to LAX @ 3:22 PM (1 stop in PHX) in Economy for $323\
-        3. United flight from LAX @ 4:00 PM to DFW @ 10:44 PM (2 stops in DCA, ORD) in Business for $977\
-        4. American flight from DFW @ 10:49 PM to DEN @ 11:58 PM (Nonstop) in First for $259\
-        5. American flight from DEN @ 11:59 PM to ATL @ 9:42 PM+1 (1 stop in CLT) in Business for $862"
+        3. United flight from LAX @ 3:29 PM to DEN @ 5:56 PM (Nonstop) in Economy for $559\
+        4. American flight from DEN @ 6:46 PM to LAX @ 10:03 PM (1 stop in PHX) in First for $274\
+        5. Spirit flight from LAX @ 10:39 PM to ATL @ 8:38 PM+1 (2 stops in DTW, FLL) in Economy for $260"
     };
 
     REQUIRE(remove_whitespace(result) == remove_whitespace(expected));
@@ -204,3 +209,616 @@ TEST_CASE("serial final d=1", "[serial],[final]") {
     REQUIRE(remove_whitespace(result) == remove_whitespace(expected));
 }
 
+
+// ids in input order, as flight_finder expects
+static std::vector<flight> renumber(std::vector<flight> flights) {
+    for(size_t i = 0; i < flights.size(); ++i) {
+        flights[i].id = i;
+    }
+    return flights;
+}
+
+TEST_CASE("serial top5 add_flights arriving later d=25", "[serial],[top5],[quick],[d],[incremental]") {
+    flight_constraints constrs = {
+        .airlines = std::nullopt,
+        .fare_class = std::nullopt,
+        .origin = std::nullopt,
+        .start_ts = std::nullopt,
+        .div_n = 25
+    };
+    std::vector<flight> flights = parse_flights_from_directory(data_dir_top5, constrs);
+    const time_t split = 1734900000; // 2024-12-22 20:40 UTC
+
+    std::vector<flight> early, late;
+    for(const flight& f : flights) {
+        (f.arrive_ts < split ? early : late).push_back(f);
+    }
+    REQUIRE(!early.empty());
+    REQUIRE(!late.empty());
+
+    std::vector<flight> all = early;
+    all.insert(all.end(), late.begin(), late.end());
+    flight_finder full(renumber(std::move(all)), constrs);
+    const std::string expected = full.search<OptLevel::SERIAL>();
+
+    flight_finder ff(renumber(std::move(early)), constrs);
+    ff.search<OptLevel::SERIAL>();
+    ff.add_flights(std::move(late));
+    const std::string result = ff.search<OptLevel::SERIAL>();
+
+    REQUIRE(result == expected);
+}
+
+TEST_CASE("serial top5 add_flights arriving earlier depart=DEN d=25", "[serial],[top5],[quick],[origin],[d],[incremental]") {
+    flight_constraints constrs = {
+        .airlines = std::nullopt,
+        .fare_class = std::nullopt,
+        .origin = std::make_optional(airport::DEN),
+        .start_ts = std::nullopt,
+        .div_n = 25
+    };
+    std::vector<flight> flights = parse_flights_from_directory(data_dir_top5, constrs);
+    const time_t split = 1734880000; // 2024-12-22 15:06 UTC
+
+    std::vector<flight> early, late;
+    for(const flight& f : flights) {
+        (f.arrive_ts < split ? early : late).push_back(f);
+    }
+    REQUIRE(!early.empty());
+    REQUIRE(!late.empty());
+
+    std::vector<flight> all = late;
+    all.insert(all.end(), early.begin(), early.end());
+    flight_finder full(renumber(std::move(all)), constrs);
+    const std::string expected = full.search<OptLevel::SERIAL>();
+
+    flight_finder ff(renumber(std::move(late)), constrs);
+    ff.search<OptLevel::SERIAL>();
+    ff.add_flights(std::move(early));
+    const std::string result = ff.search<OptLevel::SERIAL>();
+
+    REQUIRE(result == expected);
+}
+
+TEST_CASE("serial top5 remove_flight d=25", "[serial],[top5],[quick],[d],[incremental]") {
+    flight_constraints constrs = {
+        .airlines = std::nullopt,
+        .fare_class = std::nullopt,
+        .origin = std::nullopt,
+        .start_ts = std::nullopt,
+        .div_n = 25
+    };
+    std::vector<flight> flights = parse_flights_from_directory(data_dir_top5, constrs);
+
+    // cancel every third flight, kept and pruned ones alike
+    std::vector<flight> kept;
+    for(size_t i = 0; i < flights.size(); ++i) {
+        if(i % 3ul != 0ul) {
+            kept.push_back(flights[i]);
+        }
+    }
+    flight_finder full(renumber(std::move(kept)), constrs);
+    const std::string expected = full.search<OptLevel::SERIAL>();
+
+    flight_finder ff(std::move(flights), constrs);
+    ff.search<OptLevel::SERIAL>();
+    for(size_t i = 0; i < ff.stats().total; i += 3ul) {
+        ff.remove_flight(i);
+    }
+    const std::string result = ff.search<OptLevel::SERIAL>();
+
+    REQUIRE(result == expected);
+}
+
+TEST_CASE("serial top5 update_flight depart=DEN d=25", "[serial],[top5],[quick],[origin],[d],[incremental]") {
+    flight_constraints constrs = {
+        .airlines = std::nullopt,
+        .fare_class = std::nullopt,
+        .origin = std::make_optional(airport::DEN),
+        .start_ts = std::nullopt,
+        .div_n = 25
+    };
+    std::vector<flight> flights = parse_flights_from_directory(data_dir_top5, constrs);
+
+    // reprice, add a stop to, or reschedule a spread of flights
+    std::vector<flight> updated = flights;
+    for(size_t i = 0; i < updated.size(); ++i) {
+        if(i % 5ul == 0ul) {
+            updated[i].price += 10u;
+        } else if(i % 5ul == 1ul) {
+            updated[i].num_stops += 1u;
+        } else if(i % 5ul == 2ul && i % 2ul == 0ul) {
+            updated[i].depart_ts -= 3600;
+            updated[i].arrive_ts -= 3600;
+        }
+    }
+    flight_finder full(renumber(std::vector<flight>(updated)), constrs);
+    const std::string expected = full.search<OptLevel::SERIAL>();
+
+    flight_finder ff(std::move(flights), constrs);
+    ff.search<OptLevel::SERIAL>();
+    for(size_t i = 0; i < updated.size(); ++i) {
+        ff.update_flight(i, updated[i]);
+    }
+    const std::string result = ff.search<OptLevel::SERIAL>();
+
+    REQUIRE(result == expected);
+}
+
+TEST_CASE("serial top5 update_flight out of cabin depart=DEN d=25 cabin=Economy", "[serial],[top5],[quick],[origin],[d],[cabin],[incremental]") {
+    flight_constraints constrs = {
+        .airlines = std::nullopt,
+        .fare_class = std::make_optional(cabin::ECONOMY),
+        .origin = std::make_optional(airport::DEN),
+        .start_ts = std::nullopt,
+        .div_n = 25
+    };
+    std::vector<flight> flights = parse_flights_from_directory(data_dir_top5, constrs);
+
+    // moving a flight out of the cabin the finder was built for cancels it
+    flight_finder removed(std::vector<flight>(flights), constrs);
+    flight_finder updated(std::vector<flight>(flights), constrs);
+    removed.search<OptLevel::SERIAL>();
+    updated.search<OptLevel::SERIAL>();
+    for(size_t i = 0; i < flights.size(); i += 3ul) {
+        flight f = flights[i];
+        f.fare_class = cabin::BUSINESS;
+        removed.remove_flight(i);
+        updated.update_flight(i, f);
+    }
+
+    REQUIRE(updated.search<OptLevel::SERIAL>() == removed.search<OptLevel::SERIAL>());
+}
+
+TEST_CASE("serial top5 remove_flights with an unknown seq changes nothing depart=DEN d=25", "[serial],[top5],[quick],[origin],[d],[incremental]") {
+    flight_constraints constrs = {
+        .airlines = std::nullopt,
+        .fare_class = std::nullopt,
+        .origin = std::make_optional(airport::DEN),
+        .start_ts = std::nullopt,
+        .div_n = 25
+    };
+    std::vector<flight> flights = parse_flights_from_directory(data_dir_top5, constrs);
+    const size_t n = flights.size();
+
+    flight_finder reference(std::vector<flight>(flights), constrs);
+    flight_finder ff(std::move(flights), constrs);
+    const std::string before = ff.search<OptLevel::SERIAL>();
+    const prune_stats stats = ff.stats();
+
+    // every flight but the last one is real, so none of them may go
+    std::vector<size_t> batch;
+    for(size_t i = 0; i < n; i += 4ul) {
+        batch.push_back(i);
+    }
+    batch.push_back(n + 10ul);
+    REQUIRE_THROWS(ff.remove_flights(batch));
+    REQUIRE(ff.search<OptLevel::SERIAL>() == before);
+    REQUIRE(ff.stats().serialize() == stats.serialize());
+
+    batch.pop_back();
+    ff.remove_flights(batch);
+    for(size_t i : batch) {
+        reference.remove_flight(i);
+    }
+    REQUIRE(ff.search<OptLevel::SERIAL>() == reference.search<OptLevel::SERIAL>());
+}
+
+TEST_CASE("serial top5 search_ending_by depart=DEN d=25", "[serial],[top5],[quick],[origin],[d],[until]") {
+    flight_constraints constrs = {
+        .airlines = std::nullopt,
+        .fare_class = std::nullopt,
+        .origin = std::make_optional(airport::DEN),
+        .start_ts = std::nullopt,
+        .div_n = 25
+    };
+    std::vector<flight> flights = parse_flights_from_directory(data_dir_top5, constrs);
+    flight_finder ff(std::vector<flight>(flights), constrs);
+
+    // 2024-12-22 12:00, 16:00, 20:00 and 2024-12-23 00:00 UTC
+    for(time_t until : {1734868800l, 1734883200l, 1734897600l, 1734912000l}) {
+        std::vector<flight> landed;
+        for(const flight& f : flights) {
+            if(f.arrive_ts <= until) {
+                landed.push_back(f);
+            }
+        }
+        flight_finder cut(renumber(std::move(landed)), constrs);
+
+        REQUIRE(ff.search_ending_by<OptLevel::SERIAL>(until) == cut.search<OptLevel::SERIAL>());
+    }
+}
+
+TEST_CASE("serial top5 search_starting_from d=25", "[serial],[top5],[quick],[d],[since]") {
+    flight_constraints constrs = {
+        .airlines = std::nullopt,
+        .fare_class = std::nullopt,
+        .origin = std::nullopt,
+        .start_ts = std::nullopt,
+        .div_n = 25
+    };
+    std::vector<flight> flights = parse_flights_from_directory(data_dir_top5, constrs);
+    flight_finder ff(std::vector<flight>(flights), constrs);
+
+    // 2024-12-22 08:00, 12:00, 16:00 and 20:00 UTC
+    for(time_t since : {1734854400l, 1734868800l, 1734883200l, 1734897600l}) {
+        std::vector<flight> later;
+        for(const flight& f : flights) {
+            if(f.depart_ts >= since) {
+                later.push_back(f);
+            }
+        }
+        flight_finder cut(renumber(std::move(later)), constrs);
+
+        REQUIRE(ff.search_starting_from(since) == cut.search<OptLevel::SERIAL>());
+    }
+}
+
+TEST_CASE("serial top5 search_starting_from window depart=DEN d=25", "[serial],[top5],[quick],[origin],[d],[since]") {
+    flight_constraints constrs = {
+        .airlines = std::nullopt,
+        .fare_class = std::nullopt,
+        .origin = std::make_optional(airport::DEN),
+        .start_ts = std::nullopt,
+        .div_n = 25
+    };
+    std::vector<flight> flights = parse_flights_from_directory(data_dir_top5, constrs);
+    flight_finder ff(std::vector<flight>(flights), constrs);
+    ff.search<OptLevel::SERIAL>();
+
+    // windows of 8, 12 and 16 hours
+    const std::vector<std::pair<time_t, time_t> > windows = {
+        {1734854400l, 1734883200l},
+        {1734868800l, 1734912000l},
+        {1734840000l, 1734897600l},
+    };
+    for(const auto& [since, until] : windows) {
+        std::vector<flight> inside;
+        for(const flight& f : flights) {
+            if(f.depart_ts >= since && f.arrive_ts <= until) {
+                inside.push_back(f);
+            }
+        }
+        flight_finder cut(renumber(std::move(inside)), constrs);
+
+        REQUIRE(ff.search_starting_from(since, until) == cut.search<OptLevel::SERIAL>());
+    }
+}
+
+TEST_CASE("serial top5 connection rules depart=DEN d=5", "[serial],[top5],[quick],[origin],[d],[rules]") {
+    flight_constraints constrs = {
+        .airlines = std::nullopt,
+        .fare_class = std::nullopt,
+        .origin = std::make_optional(airport::DEN),
+        .start_ts = std::nullopt,
+        .div_n = 5
+    };
+    std::vector<flight> flights = parse_flights_from_directory(data_dir_top5, constrs);
+
+    // 30 minutes to connect, an hour at ATL, and at most 4 hours on the ground, 2 at DEN
+    std::fill(constrs.rules.min_connect.begin(), constrs.rules.min_connect.end(), 1800l);
+    constrs.rules.min_connect[airport::ATL] = 3600l;
+    std::fill(constrs.rules.max_layover.begin(), constrs.rules.max_layover.end(), 4l * 3600l);
+    constrs.rules.max_layover[airport::DEN] = 2l * 3600l;
+
+    flight_finder ff(std::vector<flight>(flights), constrs);
+    const std::string result = ff.search<OptLevel::SERIAL>();
+
+    constrs.memoize = true;
+    flight_finder reference(std::move(flights), constrs);
+    const std::string expected = reference.search<OptLevel::NAIVE>();
+
+    REQUIRE(result == expected);
+}
+
+TEST_CASE("serial top5 flight_window advance depart=DEN d=25", "[serial],[top5],[quick],[origin],[d],[window]") {
+    flight_constraints constrs = {
+        .airlines = std::nullopt,
+        .fare_class = std::nullopt,
+        .origin = std::make_optional(airport::DEN),
+        .start_ts = std::nullopt,
+        .div_n = 25
+    };
+    const std::vector<flight> schedule = parse_flights_from_directory(data_dir_top5, constrs);
+    const int first_day = schedule.front().day;
+
+    // the same schedule flown again on every later day
+    auto load = [&schedule, first_day](int day) -> std::vector<flight> {
+        std::vector<flight> flights = schedule;
+        for(flight& f : flights) {
+            f.depart_ts += (day - first_day) * 86400l;
+            f.arrive_ts += (day - first_day) * 86400l;
+            f.day = day;
+        }
+        return flights;
+    };
+
+    flight_window window(load, first_day, 2, constrs);
+    window.search<OptLevel::SERIAL>();
+
+    // far enough for the window to reload once
+    for(int step = 0; step < 3; ++step) {
+        window.advance();
+
+        std::vector<flight> flights;
+        for(int day = window.first_day(); day <= window.last_day(); ++day) {
+            std::vector<flight> f = load(day);
+            flights.insert(flights.end(), f.begin(), f.end());
+        }
+        flight_finder ff(renumber(std::move(flights)), constrs);
+
+        REQUIRE(window.search<OptLevel::SERIAL>() == ff.search<OptLevel::SERIAL>());
+    }
+}
+
+TEST_CASE("serial top5 arrival layout depart=DEN d=25", "[serial],[top5],[quick],[origin],[d],[layout]") {
+    flight_constraints constrs = {
+        .airlines = std::nullopt,
+        .fare_class = std::nullopt,
+        .origin = std::make_optional(airport::DEN),
+        .start_ts = std::nullopt,
+        .div_n = 25
+    };
+    std::vector<flight> flights = parse_flights_from_directory(data_dir_top5, constrs);
+    const time_t split = 1734900000; // 2024-12-22 20:40 UTC
+
+    std::vector<flight> early, late;
+    for(const flight& f : flights) {
+        (f.arrive_ts < split ? early : late).push_back(f);
+    }
+    REQUIRE(!early.empty());
+    REQUIRE(!late.empty());
+
+    flight_finder reference(std::move(flights), constrs);
+    const std::string expected = reference.search<OptLevel::SERIAL>();
+
+    constrs.layout = OptLayout::ARRIVAL;
+    flight_finder ff(renumber(std::move(early)), constrs);
+    ff.search<OptLevel::SERIAL>();
+    ff.add_flights(std::move(late));
+
+    REQUIRE(ff.search<OptLevel::SERIAL>() == expected);
+    REQUIRE(ff.search_ending_by<OptLevel::SERIAL>(split, std::nullopt) == reference.search_ending_by<OptLevel::SERIAL>(split, std::nullopt));
+}
+
+TEST_CASE("serial top5 arrival layout prefetch d=25", "[serial],[top5],[quick],[d],[layout]") {
+    flight_constraints constrs = {
+        .airlines = std::nullopt,
+        .fare_class = std::nullopt,
+        .origin = std::nullopt,
+        .start_ts = std::nullopt,
+        .div_n = 25
+    };
+    std::vector<flight> flights = parse_flights_from_directory(data_dir_top5, constrs);
+    const time_t split = 1734900000; // 2024-12-22 20:40 UTC
+    // a batch size that leaves a short last batch
+    REQUIRE(flights.size() % 7ul != 0ul);
+
+    flight_finder reference(std::vector<flight>(flights), constrs);
+    const std::string expected = reference.search<OptLevel::SERIAL>();
+    const std::string expected_by = reference.search_ending_by<OptLevel::SERIAL>(split, std::nullopt);
+
+    constrs.layout = OptLayout::ARRIVAL;
+    for(size_t prefetch : {0ul, 1ul, 7ul}) {
+        constrs.prefetch = prefetch;
+        flight_finder ff(std::vector<flight>(flights), constrs);
+        REQUIRE(ff.search<OptLevel::SERIAL>() == expected);
+        REQUIRE(ff.search_ending_by<OptLevel::SERIAL>(split, std::nullopt) == expected_by);
+    }
+}
+
+TEST_CASE("serial top5 step layout remove_flight depart=DEN d=25", "[serial],[top5],[quick],[origin],[d],[layout]") {
+    flight_constraints constrs = {
+        .airlines = std::nullopt,
+        .fare_class = std::nullopt,
+        .origin = std::make_optional(airport::DEN),
+        .start_ts = std::nullopt,
+        .div_n = 25
+    };
+    std::vector<flight> flights = parse_flights_from_directory(data_dir_top5, constrs);
+    const time_t split = 1734900000; // 2024-12-22 20:40 UTC
+
+    flight_finder reference(std::vector<flight>(flights), constrs);
+    constrs.layout = OptLayout::STEP;
+    flight_finder ff(std::move(flights), constrs);
+    REQUIRE(ff.search<OptLevel::SERIAL>() == reference.search<OptLevel::SERIAL>());
+
+    // every fifth flight cancelled, steps after the first of them are rebuilt
+    for(size_t i = 0; i < ff.stats().total; i += 5ul) {
+        ff.remove_flight(i);
+        reference.remove_flight(i);
+    }
+    REQUIRE(ff.search<OptLevel::SERIAL>() == reference.search<OptLevel::SERIAL>());
+    REQUIRE(ff.search_ending_by<OptLevel::SERIAL>(split, std::nullopt) == reference.search_ending_by<OptLevel::SERIAL>(split, std::nullopt));
+}
+
+TEST_CASE("serial top5 filter_flights matches parsing cabin=Economy d=3", "[serial],[top5],[quick],[d],[cabin],[daemon]") {
+    const flight_constraints constrs = cli_line("serial", "-c Economy -d 3 --since 1734900000");
+    REQUIRE(constrs.fare_class == std::make_optional(cabin::ECONOMY));
+    REQUIRE(constrs.div_n == std::make_optional(3u));
+    REQUIRE(constrs.since == std::vector<time_t>{1734900000});
+
+    const std::vector<flight> all = parse_flights_from_directory(data_dir_top5, flight_constraints());
+    flight_finder resident(filter_flights(all, constrs), constrs);
+    flight_finder parsed(parse_flights_from_directory(data_dir_top5, constrs), constrs);
+
+    REQUIRE(resident.search<OptLevel::SERIAL>() == parsed.search<OptLevel::SERIAL>());
+    REQUIRE(index_key(constrs) == index_key(cli_line("serial", "-d 3 -c Economy")));
+}
+
+TEST_CASE("serial top5 concurrent const search d=5", "[serial],[top5],[quick],[d],[workspace]") {
+    flight_constraints constrs = {
+        .airlines = std::nullopt,
+        .fare_class = std::nullopt,
+        .origin = std::nullopt,
+        .start_ts = std::nullopt,
+        .div_n = 5
+    };
+    std::vector<flight> flights = parse_flights_from_directory(data_dir_top5, constrs);
+    const time_t split = 1734900000; // 2024-12-22 20:40 UTC
+
+    // every origin, each on its own whole and cut short, with a second workspace rerunning the first's queries
+    std::vector<search_query> queries;
+    for(std::optional<airport> o : {std::optional<airport>(), std::make_optional(airport::ATL), std::make_optional(airport::DEN), std::make_optional(airport::LAX)}) {
+        queries.push_back({.origin = o});
+        queries.push_back({.origin = o, .end_ts = split, .dest = std::make_optional(airport::ORD)});
+    }
+
+    std::vector<std::string> expected;
+    for(const search_query& q : queries) {
+        flight_constraints c = constrs;
+        c.origin = q.origin;
+        flight_finder ff(std::vector<flight>(flights), c);
+        expected.push_back(q.end_ts.has_value() ? ff.search_ending_by<OptLevel::SERIAL>(q.end_ts.value(), q.dest) : ff.search<OptLevel::SERIAL>());
+    }
+
+    const flight_finder shared(std::move(flights), constrs);
+    std::vector<std::string> results(2ul * queries.size());
+    std::vector<std::thread> threads;
+    for(size_t t = 0; t < 2ul; ++t) {
+        threads.emplace_back([&, t]() {
+            search_workspace ws;
+            for(size_t i = 0; i < queries.size(); ++i) {
+                results[t * queries.size() + i] = shared.search(queries[i], ws);
+            }
+        });
+    }
+    for(std::thread& thread : threads) {
+        thread.join();
+    }
+
+    for(size_t i = 0; i < results.size(); ++i) {
+        REQUIRE(results[i] == expected[i % queries.size()]);
+    }
+}
+
+TEST_CASE("serial top5 query file matches one search per line d=5", "[serial],[top5],[quick],[d],[queries]") {
+    const std::vector<std::string> lines = {
+        "-d 5 --origin DEN --until 1734900000 --since 1734900000",
+        "-d 5 -c Economy",
+        "-d 5 --origin DEN --until 1734900000 --since 1734900000",
+        "-d 5 --origin ATL --layout step",
+        "--no_such_option",
+        "-d 5 --since 1734800000 --since 1734900000"
+    };
+
+    const std::vector<flight> all = parse_flights_from_directory(data_dir_top5, flight_constraints());
+    const std::vector<std::string> answers = answer_queries(all, lines);
+    REQUIRE(answers.size() == lines.size());
+    REQUIRE(answers[0] == answers[2]);
+    REQUIRE(answers[4].rfind("error: ", 0) == 0ul);
+
+    for(size_t i : {0ul, 1ul, 3ul, 5ul}) {
+        const flight_constraints constrs = cli_line("serial", lines[i]);
+        flight_finder ff(filter_flights(all, constrs), constrs);
+
+        std::stringstream expected;
+        expected << ff.search<OptLevel::SERIAL>() << std::endl;
+        for(time_t until : constrs.until) {
+            expected << "ending by " << until << ":" << std::endl << ff.search_ending_by<OptLevel::SERIAL>(until) << std::endl;
+        }
+        for(time_t since : constrs.since) {
+            expected << "starting from " << since << ":" << std::endl << ff.search_starting_from(since) << std::endl;
+        }
+        REQUIRE(answers[i] == expected.str());
+    }
+}
+
+TEST_CASE("serial top5 query file fails only the line whose --since build runs out of time d=5", "[serial],[top5],[quick],[d],[queries],[deadline]") {
+    // same finder for both, the first one's build gives up and the second builds the tables again
+    const std::vector<std::string> lines = {
+        "-d 5 --origin DEN --since 1734900000 --deadline_ms 0",
+        "-d 5 --origin DEN --since 1734900000"
+    };
+
+    const std::vector<flight> all = parse_flights_from_directory(data_dir_top5, flight_constraints());
+    const std::vector<std::string> answers = answer_queries(all, lines);
+
+    const flight_constraints constrs = cli_line("serial", lines[1]);
+    flight_finder ff(filter_flights(all, constrs), constrs);
+    REQUIRE(answers[0].rfind("error: ", 0) == 0ul);
+    REQUIRE(answers[1] == ff.search<OptLevel::SERIAL>() + "\nstarting from 1734900000:\n" + ff.search_starting_from(1734900000) + "\n");
+}
+
+TEST_CASE("serial top5 result cache hits on the same flights only d=5", "[serial],[top5],[quick],[d],[cache]") {
+    const std::vector<std::string> lines = {
+        "-d 5 --origin DEN --until 1734900000 --since 1734900000",
+        "-d 5 -c Economy --layout step"
+    };
+    const std::filesystem::path dir = std::filesystem::temp_directory_path() / "flight_finder_result_cache_test";
+    std::filesystem::remove_all(dir);
+
+    uint64_t fingerprint = 0;
+    std::vector<flight> all = parse_flights_from_directory(data_dir_top5, flight_constraints(), false, &fingerprint);
+    REQUIRE(fingerprint == flights_fingerprint(all));
+
+    const std::vector<std::string> expected = answer_queries(all, lines);
+    {
+        result_cache cache(dir.string());
+        REQUIRE(answer_queries(all, lines, &cache) == expected);
+    }
+
+    // a fresh process would only have the directory, and layout doesn't split entries
+    result_cache reloaded(dir.string());
+    const flight_constraints step = cli_line("serial", lines[1]);
+    const flight_constraints airport = cli_line("serial", "-d 5 -c Economy");
+    const std::optional<std::string> hit = reloaded.get(result_cache::key(fingerprint, airport, "search"));
+    REQUIRE(hit.has_value());
+    REQUIRE(result_cache::key(fingerprint, step, "search") == result_cache::key(fingerprint, airport, "search"));
+    REQUIRE(answer_queries(all, lines, &reloaded) == expected);
+
+    // any change to the flights is a different fingerprint
+    all.back().price += 1u;
+    REQUIRE(flights_fingerprint(all) != fingerprint);
+    REQUIRE_FALSE(reloaded.get(result_cache::key(flights_fingerprint(all), airport, "search")).has_value());
+
+    std::filesystem::remove_all(dir);
+}
+
+TEST_CASE("serial top5 search past its deadline leaves the finder intact depart=DEN d=5", "[serial],[top5],[quick],[origin],[d],[deadline]") {
+    flight_constraints constrs = {
+        .airlines = std::nullopt,
+        .fare_class = std::nullopt,
+        .origin = std::make_optional(airport::DEN),
+        .start_ts = std::nullopt,
+        .div_n = 5
+    };
+    const std::vector<flight> flights = parse_flights_from_directory(data_dir_top5, constrs);
+    const time_t split = 1734900000; // 2024-12-22 20:40 UTC
+
+    flight_finder reference(std::vector<flight>(flights), constrs);
+    const std::string expected = reference.search<OptLevel::SERIAL>();
+
+    // cancelled before it starts, so every layout gives up on its first look
+    const search_deadline cancelled = {std::nullopt, std::make_shared<const std::atomic<bool> >(true)};
+    for(OptLayout layout : {OptLayout::AIRPORT, OptLayout::ARRIVAL, OptLayout::STEP}) {
+        constrs.layout = layout;
+        flight_finder ff(std::vector<flight>(flights), constrs);
+        ff.set_deadline(cancelled);
+        REQUIRE_THROWS_AS(ff.search<OptLevel::SERIAL>(), search_expired);
+        REQUIRE_THROWS_AS(ff.search_ending_by<OptLevel::SERIAL>(split, std::nullopt), search_expired);
+
+        ff.set_deadline(search_deadline());
+        REQUIRE(ff.search<OptLevel::SERIAL>() == expected);
+        REQUIRE(ff.search_ending_by<OptLevel::SERIAL>(split, std::nullopt) == reference.search_ending_by<OptLevel::SERIAL>(split, std::nullopt));
+    }
+
+    // a const search takes the deadline in its workspace, which the next search starts over
+    search_workspace ws;
+    ws.deadline = search_deadline::after(std::chrono::milliseconds(0));
+    REQUIRE_THROWS_AS(std::as_const(reference).search({.origin = constrs.origin}, ws), search_expired);
+    ws.deadline = search_deadline();
+    REQUIRE(std::as_const(reference).search({.origin = constrs.origin}, ws) == expected);
+
+    // so does a --since lookup, whether it builds the reverse tables or, with a max layover, sweeps a window
+    const std::string since = reference.search_starting_from(split);
+    flight_finder fresh(std::vector<flight>(flights), constrs);
+    REQUIRE_THROWS_AS(fresh.search_starting_from(split, std::nullopt, cancelled), search_expired);
+    REQUIRE(fresh.search_starting_from(split) == since);
+    std::fill(constrs.rules.max_layover.begin(), constrs.rules.max_layover.end(), 4l * 3600l);
+    flight_finder bounded(std::vector<flight>(flights), constrs);
+    REQUIRE_THROWS_AS(bounded.search_starting_from(split, std::nullopt, cancelled), search_expired);
+
+    REQUIRE(search_deadline::after(std::chrono::hours(1)).expired() == false);
+    REQUIRE(search_deadline().expired() == false);
+}
@@ -0,0 +1,32 @@
+#include "../src/shard.h"
+
+#include "catch/catch.hpp"
+
+TEST_CASE("sharded search matches one process d=5", "[shard],[top5],[quick],[d]") {
+    flight_constraints constrs = {
+        .airlines = std::nullopt,
+        .fare_class = std::nullopt,
+        .origin = std::nullopt,
+        .start_ts = std::nullopt,
+        .div_n = 5
+    };
+    const flight_finder ff(parse_flights_from_directory(data_dir_top5, constrs), constrs);
+    const time_t split = 1734900000; // 2024-12-22 20:40 UTC
+
+    // batches with and without an origin, ending anywhere from before the first flight to after the last
+    std::vector<std::vector<search_query> > jobs;
+    for(std::optional<airport> o : {std::optional<airport>(), std::make_optional(airport::ATL), std::make_optional(airport::DEN)}) {
+        jobs.push_back({{.origin = o}, {.origin = o, .end_ts = split}, {.origin = o, .end_ts = 0}, {.origin = o, .end_ts = split, .dest = std::make_optional(airport::ORD)}});
+        jobs.push_back({{.origin = o, .dest = std::make_optional(airport::LAX)}});
+    }
+
+    search_workspace ws;
+    std::vector<std::vector<std::string> > expected;
+    for(const std::vector<search_query>& qs : jobs) {
+        expected.push_back(ff.search(qs, ws));
+    }
+
+    for(size_t shards : {1ul, 2ul, 4ul}) {
+        REQUIRE(sharded_search(ff, jobs, shards) == expected);
+    }
+}
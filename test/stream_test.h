@@ -0,0 +1,56 @@
+#define REMOVE_MAIN_FUNC
+#include "../src/stream.cpp"
+#undef REMOVE_MAIN_FUNC
+
+#include "catch/catch.hpp"
+
+#include <filesystem>
+
+TEST_CASE("stream top5 d=25", "[stream],[top5],[quick],[d]") {
+    flight_constraints constrs = {
+        .airlines = std::nullopt,
+        .fare_class = std::nullopt,
+        .origin = std::nullopt,
+        .start_ts = std::nullopt,
+        .div_n = 25
+    };
+    std::vector<flight> flights = parse_flights_from_directory(data_dir_top5, constrs);
+    const std::string path = (std::filesystem::temp_directory_path() / "flight_finder_stream_test.bin").string();
+
+    flight_finder ff(std::vector<flight>(flights), constrs);
+    const std::string expected = ff.search<OptLevel::SERIAL>();
+
+    write_stream(path, std::move(flights));
+    const std::string result = stream_search(path, constrs, 1ul << 20);
+
+    // a budget too small for one record fails, rather than wrapping around to no limit at all
+    REQUIRE_THROWS(stream_search(path, constrs, 0ul));
+    REQUIRE_THROWS(stream_search(path, constrs, sizeof(stream_record)));
+    std::filesystem::remove(path);
+
+    REQUIRE(result == expected);
+}
+
+TEST_CASE("stream top5 max layover depart=DEN d=5", "[stream],[top5],[quick],[origin],[d],[rules]") {
+    flight_constraints constrs = {
+        .airlines = std::nullopt,
+        .fare_class = std::nullopt,
+        .origin = std::make_optional(airport::DEN),
+        .start_ts = std::nullopt,
+        .div_n = 5
+    };
+    std::vector<flight> flights = parse_flights_from_directory(data_dir_top5, constrs);
+    const std::string path = (std::filesystem::temp_directory_path() / "flight_finder_stream_test.bin").string();
+
+    // at most 3 hours on the ground
+    std::fill(constrs.rules.max_layover.begin(), constrs.rules.max_layover.end(), 3l * 3600l);
+
+    flight_finder ff(std::vector<flight>(flights), constrs);
+    const std::string expected = ff.search<OptLevel::SERIAL>();
+
+    write_stream(path, std::move(flights));
+    const std::string result = stream_search(path, constrs, 1ul << 20);
+    std::filesystem::remove(path);
+
+    REQUIRE(result == expected);
+}
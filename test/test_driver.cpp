@@ -3,6 +3,11 @@
 
 #include "naive_test.h"
 #include "serial_test.h"
+#include "stream_test.h"
+#include "scheduler_test.h"
+#include "dataset_test.h"
+#include "shard_test.h"
+#include "daemon_test.h"
 
 TEST_CASE("catch hello_world", "[catch],[hello_world],[quick]") {
     REQUIRE(true);